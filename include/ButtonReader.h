@@ -10,6 +10,7 @@ public:
   ButtonReader(const int pin, const unsigned long debounceDelay);
 
   bool readButton(); // should be called in loop
+  bool isSettling() const;
 private:
   int m_pin;
   bool m_lastState;
@@ -10,12 +10,16 @@
 #include "backend/TransitZone.h"
 #include "backend/TimeRetriever.h"
 #include "backend/APICaller.h"
+#include "backend/AsyncAPICaller.h"
 #include "frontend/ZoneListDisplayer.h"
+#include "frontend/FontManager.h"
+#include "frontend/FrameBuffer.h"
 
 struct UserTransitZone
 {
   std::string name;
   float lat, lon, radius;
+  bool batchDepartures = false; // fetch the zone's stops several to a request
 };
 
 using UserTransitZoneList = std::vector<UserTransitZone>;
@@ -31,30 +35,34 @@ public:
   std::vector<TransitZone *> getZones() const;
   TimeRetriever *getTimeRetriever();
   APICaller *getCaller() const;
+  AsyncAPICaller *getAsyncCaller() const;
   TFT_eSPI *getTFT();
   ZoneListDisplayer *getZoneListDisplayer();
 
   const Whitelist getWhitelist() const;
+  bool isLobbyMode() const;
   const std::string getSSID() const;
   const std::string getWifiPassword() const;
   const std::string getAPIKey() const;
 
-  const uint8_t *getRegularFont() const;
-  const uint8_t *getTitleFont() const;
+  FontManager *getFontManager() const;
+  FrameBuffer *getFrameBuffer() const;
 
 private:
   TFT_eSPI m_tft;
   APICaller *m_caller;
+  std::vector<APICaller *> m_workerCallers; // for concurrent departure fetches
+  AsyncAPICaller *m_asyncCaller;            // one worker per caller in m_workerCallers
   TimeRetriever m_timeRetriever;
   ZoneListDisplayer *m_zoneListDisplayer;
+  FontManager *m_fontManager; // fonts stay loaded for the whole run
+  FrameBuffer *m_frameBuffer;
 
   std::vector<TransitZone *> m_zones;
   Whitelist m_whitelist;
+  bool m_lobbyMode;
 
   std::string m_ssid, m_password, m_apiKey;
-
-  const uint8_t *m_regularFont;
-  const uint8_t *m_titleFont;
 };
 
 #endif
\ No newline at end of file
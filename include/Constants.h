@@ -12,6 +12,9 @@ namespace Constants
   inline constexpr const char *API_CALLER_STATUS_KEY = "APICallerStatus";
   inline constexpr const char *API_HTTP_STATUS_KEY = "APICallerHTTPStatus";
   inline constexpr const char *API_DESERIALIZE_ERROR_KEY = "APICallerDeserializeError";
+  inline constexpr const char *API_RETRY_AFTER_KEY = "APICallerRetryAfter";
+
+  inline constexpr int API_REQUESTS_PER_MINUTE = 60; // the API key's quota
 
   inline constexpr int ROUTE_ERROR_PIN = 33;
   inline constexpr int STOP_ERROR_PIN = 25;
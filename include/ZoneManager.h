@@ -2,29 +2,40 @@
 #define ZONE_MANAGER_H
 
 #include <TFT_eSPI.h>
+#include <atomic>
+#include <memory>
 #include <vector>
-#include <mutex>
 #include <ctime>
 #include <string>
 
 #include "backend/TimeRetriever.h"
 #include "backend/TransitZone.h"
+#include "backend/ZoneScheduler.h"
 #include "types/TransitTypes.h"
 #include "types/DisplayTypes.h"
 #include "types/RouteList.h"
 #include "types/DepartureList.h"
 #include "types/Whitelist.h"
 #include "frontend/TransitZoneDisplayer.h"
+#include "frontend/FontManager.h"
+#include "frontend/FrameBuffer.h"
+#include "types/TaskStats.h"
+#include "types/SnapshotMailbox.h"
+#include "types/CancellationToken.h"
 
+/**
+ * Keeps one or more zones' departures fresh on a background task and shows
+ * them. With several zones, the board rotates between them.
+ */
 class ZoneManager
 {
 public:
-  ZoneManager(TransitZone *zone,
+  ZoneManager(const std::vector<TransitZone *> &zones,
               TFT_eSPI *tft,
               TimeRetriever *timeRetriever,
               const Whitelist &whitelist,
-              const uint8_t *fontRegular,
-              const uint8_t *fontLarge);
+              FrameBuffer *frameBuffer,
+              FontManager *fonts);
   ~ZoneManager();
 
   void init();
@@ -32,20 +43,69 @@ public:
   void stop();
   void drawAreYouSure();
   void cycleDisplay();
+  void requestRefresh();
+  unsigned long msUntilNextFrame() const;
+
+  void debugPrintDisplayStats() const;
+  void debugPrintTaskStats() const;
+  void debugPrintZoneStats() const;
 
 private:
-  TransitZone *m_zone;
+  struct FetchTimes
+  {
+    unsigned long startMs;
+    unsigned long finishedMs;
+  };
+
+  struct ZoneSlot
+  {
+    ZoneSlot(TransitZone *zone, TFT_eSPI *tft, FrameBuffer *frameBuffer, FontManager *fonts);
+
+    TransitZone *zone;
+    TransitZoneDisplayer displayer; // main task only
+    bool hasRoutes;                 // main task only; zones without routes are skipped
+    unsigned long lastFormatMs;     // main task only; when the shown minutes were last recomputed
+
+    // from the retrieval task and the async workers to the main task
+    SnapshotMailbox<std::vector<DisplayRoute>> routesMailbox;
+    SnapshotMailbox<std::vector<DisplayDeparture>> departuresMailbox;
+
+    // from the async workers to the retrieval task, once a zone's last batch has landed
+    std::atomic<unsigned long> fetchStartMs; // of the fetch not recorded yet; 0 if none
+    SnapshotMailbox<FetchTimes> fetchesMailbox;
+  };
+
   TimeRetriever *m_timeRetriever;
   Whitelist m_whitelist;
-  TransitZoneDisplayer m_displayer; // shared variable!
   std::time_t m_lastSyncedTime;
 
-  std::mutex m_displayerMtx;
+  std::vector<std::unique_ptr<ZoneSlot>> m_slots;
+  std::atomic<int> m_shownIdx;
+  unsigned long m_lastRotateMs;
+  ZoneScheduler m_scheduler;
+  int m_forcedIdx; // retrieval task only; zone to fetch every stop of, or -1
+
   TaskHandle_t m_retrieval_thread_handle = NULL;
+  TimerHandle_t m_refreshTimer = NULL;
+  TimerHandle_t m_timeSyncTimer = NULL;
+  SemaphoreHandle_t m_taskExited = NULL; // given by the retrieval task just before it ends
+  CancellationToken m_cancel;            // aborts the retrieval task's requests on stop()
+  TaskStats m_taskStats;
 
   static void retrievalTaskRunner(void *pvParameters);
+  static void timerCallback(TimerHandle_t timer);
+  static void timerTaskDrained(void *semaphore, uint32_t);
+  void deleteTimers();
   void bgTaskLoop();
-  void safeSetDisplayDeps(const std::vector<DisplayDeparture> &deps);
+  void runScheduledRefreshes();
+  void updateSchedule();
+  void refreshZone(const int idx);
+  void recordLandedFetches();
+  void onDeparturesPublished(ZoneSlot &slot);
+  void rotate();
+  ZoneSlot &shown() const;
+  std::vector<DisplayRoute> formatRoutes(const TransitZone *zone) const;
+  std::vector<DisplayDeparture> formatDepartures(const TransitZone *zone) const;
 };
 
-#endif
\ No newline at end of file
+#endif
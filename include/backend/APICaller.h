@@ -1,30 +1,142 @@
 #ifndef API_CALLER_H
 #define API_CALLER_H
 
+#include <atomic>
 #include <string>
+#include <map>
+#include <vector>
+#include <functional>
 #include <HTTPClient.h>
+#include <WiFiClientSecure.h>
 #include <ArduinoJson.h>
 
+#include "types/CancellationToken.h"
+#include "backend/InflateStream.h"
+
 enum class APICallerStatus
 {
   STATUS_OK,
   HTTP_ERROR,
-  DESERIALIZE_ERROR
+  DESERIALIZE_ERROR,
+  CANCELLED,
+  NOT_MODIFIED // conditional request; the previous response still holds
+};
+
+/**
+ * What a request does with the ETag and Last-Modified validators of its endpoint
+ */
+enum class CacheValidation
+{
+  OFF,       // neither sent nor remembered
+  RECORD,    // remembered from a successful response, but not sent
+  REVALIDATE // remembered, and sent so that an unchanged endpoint answers 304
+};
+
+struct APICallerStats
+{
+  unsigned long requests;       // total requests sent
+  unsigned long handshakes;     // requests that needed a new TLS connection
+  unsigned long reusedRequests; // requests sent over a kept-alive connection
+  unsigned long reconnects;     // kept-alive connections found dead and re-opened
+  unsigned long bytesReceived;  // response body bytes read
+  unsigned long parseMicros;    // time spent reading and parsing bodies
+  unsigned long peakParseHeap;  // most memory the parsed documents of one body held at once
+  unsigned long notModified;    // conditional requests answered 304
+  unsigned long bytesSaved;     // body bytes those 304s did not have to send again
+  unsigned long gzipResponses;  // bodies that arrived gzip-compressed
+  unsigned long bytesInflated;  // size of those bodies once inflated
 };
 
 class APICaller
 {
 public:
-  APICaller(const std::string &apiKey);
+  using ElementCallback = std::function<void(JsonVariantConst &)>;
+
+  struct Validators
+  {
+    std::string etag;
+    std::string lastModified;
+    std::string next;  // the page's meta.next, which a 304 does not repeat
+    size_t bodyBytes; // size of the response they validate
+  };
+  using ValidatorMap = std::map<std::string, Validators>; // by endpoint, without the API key
+
+  APICaller(const std::string &apiKey,
+            const bool keepAlive = false,
+            const bool streaming = false,
+            const bool gzip = false);
 
   JsonDocument call(const std::string &endpoint,
                     const JsonDocument &filter,
                     const int nestingLimit = ARDUINOJSON_DEFAULT_NESTING_LIMIT,
-                    const bool attachApiKey = true);
+                    const bool attachApiKey = true,
+                    const CancellationToken &cancel = CancellationToken::none(),
+                    const CacheValidation validation = CacheValidation::OFF);
+  JsonDocument callStreaming(const std::string &endpoint,
+                             const JsonDocument &filter,
+                             const std::string &arrKeyName,
+                             const ElementCallback &onElement,
+                             const int nestingLimit = ARDUINOJSON_DEFAULT_NESTING_LIMIT,
+                             const bool attachApiKey = true,
+                             const CancellationToken &cancel = CancellationToken::none(),
+                             const CacheValidation validation = CacheValidation::OFF);
+
+  bool isKeepAlive() const;
+  void setKeepAlive(const bool keepAlive);
+  bool isStreaming() const;
+  void setStreaming(const bool streaming);
+  bool isGzip() const;
+  void setGzip(const bool gzip);
+
+  ValidatorMap exportValidators(const std::vector<std::string> &endpoints) const;
+  void importValidators(const ValidatorMap &validators);
+
+  APICallerStats getStats() const;
+  void debugPrintStats() const;
 
 private:
+  /**
+   * Heap allocator for parsed documents that keeps count of what they hold,
+   * so a parse's peak is its own rather than the whole heap's
+   */
+  class ParseAllocator : public ArduinoJson::Allocator
+  {
+  public:
+    void *allocate(size_t size) override;
+    void deallocate(void *ptr) override;
+    void *reallocate(void *ptr, size_t newSize) override;
+
+    void beginParse();
+    size_t parsePeak() const;
+
+  private:
+    std::atomic<size_t> m_held{0}; // documents may be freed on other tasks
+    size_t m_start = 0;
+    size_t m_peak = 0;
+
+    void add(const size_t size);
+  };
+
   std::string m_apiKey;
+  bool m_keepAlive;
+  bool m_streaming;
+  bool m_gzip;
+  WiFiClientSecure m_secureClient; // owned so the TLS connection outlives each request
   HTTPClient m_client;
+  InflateStream m_inflate; // buffers allocated on the first gzip body and kept
+  ParseAllocator m_parseAllocator; // outlives every document it allocated, like the caller
+  APICallerStats m_stats;
+  ValidatorMap m_validators;
+
+  int sendRequest(const std::string &endpoint, const Validators *validators = nullptr);
+  JsonDocument httpErrorResponse(const int httpCode);
+  Stream *openBody(Stream &decoded, bool &gzipped);
+  size_t closeBody(const bool gzipped, const size_t readBytes, const bool parsed);
+  const Validators *findValidators(const std::string &endpoint, const CacheValidation validation) const;
+  void rememberValidators(const std::string &pageEndpoint, JsonVariantConst next, const size_t bodyBytes);
+  JsonDocument notModifiedResponse(const Validators &validators);
+  void recordParse(const unsigned long startMicros);
+  void closeConnection();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,91 @@
+#ifndef ASYNC_API_CALLER_H
+#define ASYNC_API_CALLER_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <Arduino.h>
+
+#include "backend/APICaller.h"
+
+// runs on a worker with that worker's caller; returns whether it succeeded
+using AsyncJob = std::function<bool(APICaller *caller)>;
+// runs on the worker right after its job
+using AsyncCompletion = std::function<void(const bool ok)>;
+
+/**
+ * Handle to a submitted job; wait() blocks until it has run
+ */
+class AsyncRequest
+{
+public:
+  AsyncRequest(const AsyncJob &job, const AsyncCompletion &onDone);
+  ~AsyncRequest();
+
+  bool wait();
+  bool isDone() const;
+
+private:
+  friend class AsyncAPICaller;
+
+  AsyncJob m_job;
+  AsyncCompletion m_onDone;
+  SemaphoreHandle_t m_done;
+  std::atomic<bool> m_finished;
+  bool m_ok; // written before m_finished is set
+
+  void run(APICaller *caller);
+};
+
+using AsyncRequestPtr = std::shared_ptr<AsyncRequest>;
+
+/**
+ * Keeps several API requests in flight at once
+ *
+ * Each caller gets a persistent task that takes jobs off a shared queue,
+ * so as many requests are outstanding as there are callers, each on its
+ * own kept-alive connection. Submitting never blocks; results come back
+ * through the completion callback or the returned handle.
+ *
+ * The callers must not be used elsewhere while jobs may be running.
+ */
+class AsyncAPICaller
+{
+public:
+  AsyncAPICaller(const std::vector<APICaller *> &callers);
+  ~AsyncAPICaller();
+
+  bool begin();
+  AsyncRequestPtr submit(const AsyncJob &job, const AsyncCompletion &onDone = nullptr);
+
+  int getWorkerCount() const;
+  int getInFlight() const;
+  void debugPrintStats() const;
+
+private:
+  struct Worker
+  {
+    AsyncAPICaller *inst;
+    APICaller *caller;
+    TaskHandle_t handle;
+  };
+
+  std::vector<APICaller *> m_callers;
+  std::vector<Worker> m_workers; // one per caller once started
+
+  std::mutex m_queueMtx; // guards m_queue
+  std::deque<AsyncRequestPtr> m_queue;
+  SemaphoreHandle_t m_queued; // counts jobs in m_queue
+
+  std::atomic<int> m_inFlight; // queued or running
+  std::atomic<int> m_peakInFlight;
+  std::atomic<unsigned long> m_completed;
+
+  static void workerTaskRunner(void *pvParameters);
+  void workerLoop(APICaller *caller);
+};
+
+#endif
@@ -2,7 +2,9 @@
 #define BASE_RETRIEVER_H
 
 #include "backend/APICaller.h"
+#include "types/CancellationToken.h"
 #include <string>
+#include <vector>
 #include <ArduinoJson.h>
 
 class BaseRetriever
@@ -16,6 +18,11 @@ public:
   virtual bool retrieve() = 0;
   std::string getEndpoint() const;
   void setEndpoint(const std::string &endpoint);
+  void setCancellationToken(const CancellationToken &cancel);
+  void setCacheValidation(const CacheValidation validation);
+  bool isUnchanged() const;
+  std::vector<std::string> getPageEndpoints() const;
+  int getRequestCount() const;
 
 protected:
   bool loopRequest(const JsonDocument &filter,
@@ -28,7 +35,18 @@ private:
   std::string m_endpoint;
   int m_maxPages;
   int m_errorPin;
+  const CancellationToken *m_cancel;
+  CacheValidation m_validation;
+  bool m_unchanged;
+  std::vector<std::string> m_pageEndpoints; // requested by the last retrieve()
+  int m_requests;                           // sent by the last retrieve(), retries included
 
+  bool requestPages(const JsonDocument &filter,
+                    const std::string &arrKeyName,
+                    const int nestingLimit,
+                    CacheValidation validation,
+                    int &pages,
+                    int &notModifiedPages);
   void writePinIfExists(int state);
 };
 
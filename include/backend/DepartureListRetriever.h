@@ -1,39 +1,94 @@
 #ifndef DEPARTURE_LIST_RETRIEVER_H
 #define DEPARTURE_LIST_RETRIEVER_H
 
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <Arduino.h>
+
 #include "types/TransitTypes.h"
 #include "types/RouteList.h"
 #include "types/StopList.h"
 #include "types/DepartureList.h"
+#include "types/CancellationToken.h"
 #include "backend/APICaller.h"
+#include "backend/AsyncAPICaller.h"
 #include "backend/TimeRetriever.h"
 #include "backend/DepartureRetriever.h"
 
 /**
  * Fetches departures from MULTIPLE transitland stops for a SINGLE TransitZone
+ *
+ * Each stop is refetched on its own interval: often when a real-time
+ * departure is close or its departures keep changing, rarely when the next
+ * one is far off, only scheduled, or nothing changed last time. Stops that
+ * are not due keep their last departures. Zones configured for it fetch
+ * their due stops several to a request.
+ *
+ * With an async caller, retrieveAsync() hands the due batches to its workers
+ * and returns; each batch is merged in and published as soon as it lands.
  */
 class DepartureListRetriever
 {
 public:
+  using PublishCallback = std::function<void()>;
+
   DepartureListRetriever(
       APICaller *caller,
       TimeRetriever *time,
       const DepartureRetrieverConfig &config);
 
-  void init(RouteList routeList, StopList stopList);
+  void init(const RouteListPtr &routeList, const StopListPtr &stopList);
+  void setAsyncCaller(AsyncAPICaller *async);
+  void setOnPublished(const PublishCallback &onPublished);
   void clear();
-  bool retrieve();
+  bool retrieve(const CancellationToken &cancel = CancellationToken::none(), const bool allStops = false);
+  bool retrieveAsync(const bool allStops = false);
+  void cancelInFlight();
 
-  DepartureList getDepartureList() const;
+  DepartureListPtr getDepartureList() const;
+  int getDueRequestCount(const bool allStops = false) const;
+  unsigned long msUntilNextDue() const;
+  bool hasInFlight() const;
+  void debugPrintStats() const;
 
 private:
+  struct StopState
+  {
+    DepartureList departures; // from the last successful fetch
+    unsigned long fetchedMs;  // last fetch attempt; 0 if never
+    unsigned long intervalMs; // until the next fetch is due
+    bool inFlight;            // in a batch handed to the async caller that has not landed yet
+  };
+
   TimeRetriever *m_time;
   APICaller *m_caller;
+  AsyncAPICaller *m_async; // fetches several batches at once; nullptr to fetch one at a time
 
   std::vector<Stop> m_stops;
-  RouteList m_routeList;
-  DepartureList m_departureList;
+  RouteListPtr m_routeList; // use atomic_load/atomic_store
+  DepartureListPtr m_published; // last complete list; use atomic_load/atomic_store
   DepartureRetrieverConfig m_config;
+
+  std::vector<StopState> m_stopStates; // one per stop; guarded by m_statesMtx
+  mutable std::mutex m_statesMtx;
+  unsigned long m_statsStartMs;
+  std::atomic<unsigned long> m_requests;
+
+  std::vector<AsyncRequestPtr> m_inFlight; // batches from retrieveAsync(); guarded by m_statesMtx
+  CancellationToken m_asyncCancel;         // cancels those batches, which outlive any caller's token
+  std::mutex m_publishMtx;                 // so lists from two batches are published in order
+  PublishCallback m_onPublished;
+
+  std::vector<std::vector<int>> collectDueBatches(const bool allStops);
+  bool retrieveSequential(const std::vector<std::vector<int>> &batches, const CancellationToken &cancel);
+  bool retrieveParallel(const std::vector<std::vector<int>> &batches, const CancellationToken &cancel);
+  void waitForInFlight();
+  bool fetchStops(APICaller *caller, const std::vector<int> &stopIdxs, const CancellationToken &cancel);
+  bool isDue(const StopState &state, const unsigned long now) const;
+  unsigned long nextInterval(const StopState &state, const DepartureList &fetched) const;
+  void publish();
 };
 
 #endif
\ No newline at end of file
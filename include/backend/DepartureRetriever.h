@@ -1,6 +1,8 @@
 #ifndef DEPARTURE_RETRIEVER_H
 #define DEPARTURE_RETRIEVER_H
 
+#include <vector>
+
 #include "types/DepartureList.h"
 #include "types/RouteList.h"
 #include "types/TransitTypes.h"
@@ -13,10 +15,13 @@ struct DepartureRetrieverConfig
   int departureLimit;
   int nextNSeconds;
   int timestampCutoff;
+  int parallelism;     // max requests in flight at once
+  int stopsPerRequest; // stops fetched together in one departures request; 1 fetches each on its own
 };
 
 /**
- * Fetches departures from a SINGLE TransitLand stop
+ * Fetches departures from one TransitLand stop, or from several stops in a
+ * single batched request, keeping each stop's departures separate
  */
 class DepartureRetriever : public BaseRetriever
 {
@@ -24,25 +29,35 @@ public:
   DepartureRetriever(APICaller *caller,
                      TimeRetriever *time,
                      const Stop &stop,
-                     const RouteList &routeList,
+                     const RouteListPtr &routeList,
+                     const DepartureRetrieverConfig &departureConfig);
+  DepartureRetriever(APICaller *caller,
+                     TimeRetriever *time,
+                     const std::vector<Stop> &stops,
+                     const RouteListPtr &routeList,
                      const DepartureRetrieverConfig &departureConfig);
 
   virtual bool retrieve() override;
-  DepartureList getDepartureList() const;
+  static const JsonDocument &getFilter();
+  DepartureList getDepartureList(const int stopIdx = 0) const;
+  bool wasReturned(const int stopIdx) const;
 
 protected:
   virtual void parseOneElement(JsonVariantConst &doc) override;
 
 private:
   TimeRetriever *m_time;
-  Stop m_stop;
-  RouteList m_routeList;
-  DepartureList m_departures;
+  std::vector<Stop> m_stops;
+  RouteListPtr m_routeList; // shared, never copied
+  std::vector<DepartureList> m_departures; // one per stop
+  std::vector<bool> m_returned;            // one per stop; whether the response had it
+  int m_curStopIdx;                        // stop whose departures are being parsed
   DepartureRetrieverConfig m_departureConfig;
 
   static JsonDocument constructFilter();
   static std::string constructEndpointString(
-      const Stop &stop, const int departureLimit, const int nextNSeconds);
+      const std::vector<Stop> &stops, const int departureLimit, const int nextNSeconds);
+  int findStop(JsonVariantConst &stopInfo) const;
   void parseOneDeparture(JsonVariantConst &doc);
 
   bool retrieveIsRealTime(JsonVariantConst &doc, Departure &dep);
@@ -50,7 +65,7 @@ private:
   bool retrieveRoute(JsonVariantConst &doc, Departure &dep);
   bool retrieveTimestampDelay(JsonVariantConst &doc, Departure &dep);
 
-  std::time_t convertTime(const std::string &str);
+  static std::time_t convertTime(const char *str);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef INFLATE_STREAM_H
+#define INFLATE_STREAM_H
+
+#include <Arduino.h>
+#include <rom/miniz.h>
+
+/**
+ * Reads a gzip body from another stream and hands out the inflated bytes
+ *
+ * Uses the inflater in the ESP32 ROM. Its 32 KB window and state are
+ * allocated on the first begin(), in PSRAM when there is some, and reused
+ * for every response after that.
+ */
+class InflateStream : public Stream
+{
+public:
+  InflateStream();
+  ~InflateStream();
+
+  bool begin(Stream &upstream);
+  bool finish();
+  void end();
+
+  int available() override;
+  int peek() override;
+  int read() override;
+  size_t readBytes(char *buffer, size_t length) override;
+  size_t write(uint8_t) override { return 0; }
+
+  size_t compressedCount() const;
+  size_t inflatedCount() const;
+  bool failed() const;
+
+private:
+  Stream *m_upstream;
+  tinfl_decompressor *m_decomp;
+  uint8_t *m_window; // circular; inflated bytes are read straight out of it
+  uint8_t *m_input;
+
+  size_t m_inputPos, m_inputLen;
+  size_t m_outPos;   // where the inflater writes next
+  size_t m_readPos;  // next inflated byte to hand out
+  size_t m_pending;  // inflated bytes not handed out yet
+  size_t m_compressed, m_inflated;
+  bool m_finished, m_failed;
+
+  bool allocate();
+  void release();
+  bool readHeader();
+  bool skipUpstream(size_t length);
+  bool skipUpstreamString();
+  bool refillInput();
+  bool fill();
+  void consumeTrailer();
+};
+
+#endif
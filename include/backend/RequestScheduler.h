@@ -0,0 +1,39 @@
+#ifndef REQUEST_SCHEDULER_H
+#define REQUEST_SCHEDULER_H
+
+#include "types/CancellationToken.h"
+
+struct RequestSchedulerStats
+{
+  unsigned long granted;     // requests let through
+  unsigned long waitedMs;    // total time spent waiting for the budget
+  unsigned long rateLimited; // 429 responses
+  unsigned long retries;     // requests sent again after a transient failure
+  unsigned long pausedMs;    // total time every request was held back after a 429
+};
+
+/**
+ * Process-wide budget for API requests, shared by every task and caller
+ *
+ * A token bucket refilled at the API key's quota lets requests out as fast
+ * as the budget allows. A 429 pauses everyone, for Retry-After when the
+ * server gives one. This is the only limiter; schedulers above it only ask
+ * how much budget there is. Thread safe.
+ */
+class RequestScheduler
+{
+public:
+  static void configure(const int requestsPerMinute, const int burst);
+
+  static bool acquire(const CancellationToken &cancel = CancellationToken::none());
+  static unsigned long msUntilAvailable(const int requests);
+  static void pauseFor(const unsigned long ms);
+  static void recordRateLimited();
+  static void recordRetry();
+  static unsigned long backoffMs(const int attempt);
+
+  static RequestSchedulerStats getStats();
+  static void debugPrintStats();
+};
+
+#endif
@@ -16,6 +16,7 @@ public:
   RouteRetriever(APICaller *caller, float lat, float lon, float radius, const Whitelist &whiteList);
 
   virtual bool retrieve() override;
+  static const JsonDocument &getFilter();
   RouteList getRouteList() const;
 
   Whitelist getWhiteList() const;
@@ -16,6 +16,7 @@ public:
   StopRetriever(APICaller *caller, float lat, float lon, float radius, const Whitelist &whiteList);
 
   virtual bool retrieve() override;
+  static const JsonDocument &getFilter();
   StopList getStopList() const;
 
   Whitelist getWhiteList() const;
@@ -12,11 +12,71 @@ public:
   std::time_t getCurTime() const;
   static std::time_t timegmUTC(struct tm *timeinfo);
 
+  /**
+   * Parses a "YYYY-MM-DDTHH:MM:SSZ" UTC timestamp into seconds since the epoch
+   *
+   * Pure arithmetic: no allocation, no locale or TZ state. Returns -1 if malformed.
+   */
+  static constexpr std::time_t parseISO8601UTC(const char *str)
+  {
+    if (str == nullptr)
+      return -1;
+
+    const int year = parseDigits(str, 4);
+    if (year < 0 || str[4] != '-')
+      return -1;
+    const int month = parseDigits(str + 5, 2);
+    if (month < 1 || month > 12 || str[7] != '-')
+      return -1;
+    const int day = parseDigits(str + 8, 2);
+    if (day < 1 || day > 31 || str[10] != 'T')
+      return -1;
+    const int hour = parseDigits(str + 11, 2);
+    if (hour < 0 || hour > 23 || str[13] != ':')
+      return -1;
+    const int minute = parseDigits(str + 14, 2);
+    if (minute < 0 || minute > 59 || str[16] != ':')
+      return -1;
+    const int second = parseDigits(str + 17, 2);
+    if (second < 0 || second > 60)
+      return -1;
+
+    return daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+  }
+
+  /**
+   * Days since 1970-01-01 in the proleptic Gregorian calendar
+   *
+   * See http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+   */
+  static constexpr std::time_t daysFromCivil(int year, const int month, const int day)
+  {
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+    const unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return static_cast<std::time_t>(era) * 146097 + static_cast<std::time_t>(dayOfEra) - 719468;
+  }
+
 private:
   static std::time_t espRetrieveTime();
 
+  // returns -1 if any of the count characters is not a digit
+  static constexpr int parseDigits(const char *str, const int count)
+  {
+    int res = 0;
+    for (int i = 0; i < count; i++)
+    {
+      if (str[i] < '0' || str[i] > '9')
+        return -1;
+      res = res * 10 + (str[i] - '0');
+    }
+    return res;
+  }
+
   std::time_t m_startTimeSeconds;
   std::time_t m_startTimeUTC;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,7 +2,9 @@
 #define TRANSIT_ZONE_H
 
 #include <atomic>
+#include <ctime>
 #include <string>
+#include <vector>
 
 #include "backend/TimeRetriever.h"
 #include "backend/APICaller.h"
@@ -11,6 +13,7 @@
 #include "types/RouteList.h"
 #include "types/StopList.h"
 #include "types/DepartureList.h"
+#include "types/CancellationToken.h"
 
 enum class TransitZoneStatus
 {
@@ -38,35 +41,61 @@ public:
   float getRadius() const;
   bool isInitialized() const;
   bool isValid() const;
+  bool needsRevalidation() const;
+  bool hasDeparturesNewerThan(const unsigned long maxAgeMs) const;
+  unsigned long getDeparturesFetchedMs() const;
+  int getDueRequestCount(const bool allStops = false) const;
+  unsigned long msUntilDeparturesDue() const;
+  bool hasPendingDepartures() const;
 
-  RouteList getRoutes() const;
-  DepartureList getDepartures() const;
+  RouteListPtr getRoutes() const;
+  DepartureListPtr getDepartures() const;
   TransitZoneStatus getStatus() const;
   Whitelist getWhitelist() const;
 
+  void setAsyncCaller(AsyncAPICaller *async);
+  void setOnDeparturesPublished(const DepartureListRetriever::PublishCallback &onPublished);
+
   void init();
-  void init(const Whitelist &whitelist);
-  void callDeparturesAPI();
+  void init(const Whitelist &whitelist, const CancellationToken &cancel = CancellationToken::none());
+  void revalidate(const CancellationToken &cancel = CancellationToken::none());
+  void callDeparturesAPI(const CancellationToken &cancel = CancellationToken::none(), const bool allStops = false);
+  void requestDepartures(const CancellationToken &cancel = CancellationToken::none(), const bool allStops = false);
+  void cancelPendingDepartures();
   void clearDepartures();
 
   void debugPrint();
+  void debugPrintRefreshStats() const;
 
 private:
   std::string m_name;
   float m_lat, m_lon, m_radius;
-  bool m_isValid;
-  bool m_isInitialized;
+  std::atomic<bool> m_isValid;
+  std::atomic<bool> m_isInitialized; // set last, so readers see the catalogs it guards
+  std::time_t m_catalogsCheckedAt; // when routes and stops were last downloaded or revalidated
+  std::atomic<unsigned long> m_departuresFetchedMs; // 0 if departures were never published
   Whitelist m_whitelist;
   std::atomic<TransitZoneStatus> m_status;
 
   APICaller *m_caller;
   TimeRetriever *m_time;
 
-  RouteList m_routeList;
-  StopList m_stopList;
+  RouteListPtr m_routeList; // use atomic_load/atomic_store
+  StopListPtr m_stopList;   // use atomic_load/atomic_store
+  APICaller::ValidatorMap m_catalogValidators; // of the route and stop pages
   DepartureListRetriever m_departureListRetriever;
+  DepartureListRetriever::PublishCallback m_onDeparturesPublished;
 
-  StopList getStops() const;
+  StopListPtr getStops() const;
+  void setCatalogs(RouteList &&routes, StopList &&stops);
+  bool retrieveCatalogs(const Whitelist &whitelist,
+                        RouteList &routes,
+                        StopList &stops,
+                        const CancellationToken &cancel,
+                        const CacheValidation validation,
+                        APICaller::ValidatorMap &validators,
+                        bool &unchanged);
+  void finishInit(const Whitelist &whitelist);
 };
 
 #endif
\ No newline at end of file
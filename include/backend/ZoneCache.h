@@ -0,0 +1,43 @@
+#ifndef ZONE_CACHE_H
+#define ZONE_CACHE_H
+
+#include <ctime>
+#include <cstdint>
+#include <string>
+
+#include "backend/APICaller.h"
+#include "types/RouteList.h"
+#include "types/StopList.h"
+#include "types/Whitelist.h"
+
+/**
+ * Persists the routes and stops of a TransitZone to flash
+ *
+ * Entries are keyed by location, radius and whitelist, so a changed zone
+ * configuration never reads a stale entry. The validators of the catalog
+ * pages are kept with them, so they can be revalidated after a restart.
+ */
+class ZoneCache
+{
+public:
+  ZoneCache(const float lat, const float lon, const float radius, const Whitelist &whitelist);
+
+  static bool begin(); // mounts the filesystem, call once at startup
+
+  bool load(RouteList &routes,
+            StopList &stops,
+            APICaller::ValidatorMap &validators,
+            std::time_t &savedAt) const;
+  bool save(const RouteList &routes,
+            const StopList &stops,
+            const APICaller::ValidatorMap &validators,
+            const std::time_t savedAt) const;
+  void remove() const;
+
+private:
+  std::string m_path;
+
+  static uint32_t hashKey(const float lat, const float lon, const float radius, const Whitelist &whitelist);
+};
+
+#endif
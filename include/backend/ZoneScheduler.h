@@ -0,0 +1,66 @@
+#ifndef ZONE_SCHEDULER_H
+#define ZONE_SCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <Arduino.h>
+
+struct ZoneFetchStats
+{
+  unsigned long lastFetchMs;    // when the last fetch finished; 0 if never
+  unsigned long lastLatencyMs;  // how long the last fetch took
+  unsigned long totalLatencyMs; // summed over all fetches
+  unsigned long fetches;
+};
+
+/**
+ * Decides which of several zones to refresh next, so that all of them
+ * stay fresh on the one API request budget.
+ *
+ * The zone on screen is refreshed every shownPeriodMs and goes first;
+ * the others every hiddenPeriodMs, stalest first. A zone that says when it
+ * is next due (setDueIn) is refreshed then instead of on the shown period;
+ * hidden zones still wait at least hiddenPeriodMs. With several zones, a
+ * zone is only picked once RequestScheduler has budget for its whole
+ * refresh; the requests themselves are paced there. A zone whose fetch is
+ * still in flight is not picked again until it lands.
+ *
+ * Not thread safe; used only by the retrieval task once it runs.
+ */
+class ZoneScheduler
+{
+public:
+  ZoneScheduler(const int numZones,
+                const unsigned long shownPeriodMs,
+                const unsigned long hiddenPeriodMs);
+
+  int next(const int shownIdx, unsigned long &waitMs);
+  void force(const int idx);
+  void setCost(const int idx, const int requests);
+  void setDueIn(const int idx, const unsigned long ms);
+  void setInFlight(const int idx, const bool inFlight);
+  void seed(const int idx, const unsigned long fetchedMs);
+  void recordFetch(const int idx, const unsigned long startMs, const unsigned long finishedMs);
+
+  ZoneFetchStats getStats(const int idx) const;
+  unsigned long getStalenessMs(const int idx) const;
+  void debugPrint(const std::vector<std::string> &names) const;
+
+private:
+  struct ZoneState
+  {
+    ZoneFetchStats stats;
+    int cost;            // requests one refresh is expected to send
+    bool forced;         // refresh as soon as the budget allows
+    bool adaptive;       // dueAtMs is used instead of the shown period
+    bool inFlight;       // fetch requested and not finished yet
+    unsigned long dueAtMs;
+  };
+
+  std::vector<ZoneState> m_zones;
+  unsigned long m_shownPeriod, m_hiddenPeriod;
+
+  unsigned long msUntilDue(const int idx, const bool shown) const;
+};
+
+#endif
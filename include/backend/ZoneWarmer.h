@@ -0,0 +1,45 @@
+#ifndef ZONE_WARMER_H
+#define ZONE_WARMER_H
+
+#include <mutex>
+#include <vector>
+#include <Arduino.h>
+
+#include "backend/TransitZone.h"
+#include "types/Whitelist.h"
+#include "types/CancellationToken.h"
+
+/**
+ * Initializes zones and fetches their departures on a background task
+ * while the user is still choosing one, so a selected zone starts warm.
+ *
+ * Only one of this and a running ZoneManager may use the API at a time;
+ * call stop() before starting a zone.
+ */
+class ZoneWarmer
+{
+public:
+  ZoneWarmer(const Whitelist &whitelist);
+
+  void begin();
+  void warm(const std::vector<TransitZone *> &zones);
+  void stop();
+
+private:
+  Whitelist m_whitelist;
+  TaskHandle_t m_taskHandle = NULL;
+
+  std::mutex m_pendingMtx; // guards m_pending, m_current and resetting m_cancel
+  std::vector<TransitZone *> m_pending;
+  TransitZone *m_current = nullptr; // being warmed
+  CancellationToken m_cancel;
+  std::mutex m_workMtx; // held by the task while it warms zones
+
+  static void taskRunner(void *pvParameters);
+  void taskLoop();
+  bool takeNext(TransitZone *&zone);
+  void finishCurrent();
+  void warmZone(TransitZone *zone);
+};
+
+#endif
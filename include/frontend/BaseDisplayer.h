@@ -3,13 +3,28 @@
 
 #include <Arduino.h>
 
+struct FrameStats
+{
+  unsigned long frames;
+  unsigned long totalMicros;
+  unsigned long maxMicros;
+  unsigned long lastMicros;
+};
+
 class BaseDisplayer
 {
 public:
   static uint16_t hexToRGB565(uint32_t hexColor);
   virtual void cycle() = 0;
 
+  FrameStats getFrameStats() const;
+  void debugPrintFrameStats(const char *name) const;
+
+protected:
+  void recordFrame(const unsigned long startMicros);
+
 private:
+  FrameStats m_frameStats = {};
 };
 
 #endif
\ No newline at end of file
@@ -8,23 +8,68 @@
 
 #include "types/DisplayTypes.h"
 #include "frontend/BaseDisplayer.h"
+#include "frontend/FontManager.h"
+
+// vertical band of the screen that was repainted
+struct DirtyBand
+{
+  int y;
+  int h;
+};
+
+struct PaintStats
+{
+  unsigned long fullRepaints;
+  unsigned long partialRepaints;
+  unsigned long lastPixels;  // pixels painted by the last cycle
+  unsigned long totalPixels; // pixels painted since start
+};
 
 class DeparturesDisplayer : public BaseDisplayer
 {
 public:
-  DeparturesDisplayer(TFT_eSPI *tft, const uint8_t *fontRegular);
+  DeparturesDisplayer(TFT_eSPI *tft, FontManager *fonts);
 
   void drawBlankDepartureSpace();
   void setDepartures(const std::vector<DisplayDeparture> &departures);
+  void setDepartures(std::vector<DisplayDeparture> &&departures);
 
   void cycle();
+  void invalidate();
+
+  const std::vector<DirtyBand> &getDirtyBands() const;
+  PaintStats getPaintStats() const;
+  void debugPrintPaintStats() const;
+
+  static int getRegionY();
+  static int getRegionHeight();
 
 private:
+  // what a row last drew; each group of fields is one cell
+  struct RowState
+  {
+    bool visible = false;
+    std::string line; // badge
+    int routeColor = 0;
+    int textColor = 0;
+    std::string direction; // direction
+    std::string minsText;  // minutes
+    int delayColor = 0;
+  };
+
   TFT_eSPI *m_tft;
-  const uint8_t *m_fontRegular;
+  FontManager *m_fonts;
   std::vector<DisplayDeparture> m_departures;
   std::time_t m_lastUpdated; // in relative time - millis(), ms
 
+  std::vector<RowState> m_rows;
+  bool m_retainedValid; // false once something else has drawn over the region
+  bool m_showingEmpty;  // "No departures found" is on screen
+  std::vector<DirtyBand> m_dirtyBands;
+  PaintStats m_paintStats;
+
+  void drawRow(const int idx, const RowState &next, const int maxDirectionWidth, const int minsCellX);
+  void clearCell(const int x, const int y, const int w, const int h);
   std::string truncateText(const std::string &text, int maxWidth);
   void updateDepartureMins();
 };
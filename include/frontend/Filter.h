@@ -2,6 +2,7 @@
 #define FILTER_H
 
 #include "types/DisplayTypes.h"
+#include "types/StringInterner.h"
 #include <string>
 #include <vector>
 
@@ -14,7 +15,7 @@ public:
 private:
   static std::string truncateStop(const std::string &name, const bool truncateDowntown);
   static std::string truncateRoute(const std::string &routeStr);
-  static void modifyAgentSpecific(DisplayDeparture &dep, const std::string &agencyOnestopId);
+  static void modifyAgentSpecific(DisplayDeparture &dep, const InternId agencyOnestopId);
 
   // ROUTES: TRANSIT-SPECIFIC AGENCIES BELOW
   static void modifyRoutesLAMetro(std::vector<DisplayRoute> &routes);
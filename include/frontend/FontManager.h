@@ -0,0 +1,75 @@
+#ifndef FONT_MANAGER_H
+#define FONT_MANAGER_H
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <vector>
+#include <memory>
+
+#include "frontend/TextMeasurer.h"
+
+struct FontManagerStats
+{
+  unsigned long loads;      // fonts parsed from their VLW arrays
+  unsigned long swaps;      // cached metrics switched onto a target
+  unsigned long hits;       // requested font was already active
+  unsigned long loadMicros; // time spent parsing fonts
+};
+
+/**
+ * Loads each smooth font once and switches fonts by swapping its cached glyph
+ * metrics onto a TFT_eSPI (or sprite) instead of re-parsing the VLW array.
+ *
+ * Fonts stay loaded for the life of the manager; call release() before
+ * deleting a sprite that used one. Main thread only.
+ */
+class FontManager
+{
+public:
+  FontManager(const uint8_t *regularFont, const uint8_t *titleFont);
+  ~FontManager();
+
+  void useRegular(TFT_eSPI *tft);
+  void useTitle(TFT_eSPI *tft);
+  void use(TFT_eSPI *tft, const uint8_t *font);
+  void release(TFT_eSPI *tft);
+
+  TextMeasurer *measurer(TFT_eSPI *tft);
+
+  FontManagerStats getStats() const;
+  void debugPrintStats() const;
+
+private:
+  // snapshot of the metrics TFT_eSPI::loadFont builds
+  struct CachedFont
+  {
+    const uint8_t *font;
+    TFT_eSPI::fontMetrics metrics;
+    uint16_t *unicode;
+    uint8_t *height;
+    uint8_t *width;
+    uint8_t *xAdvance;
+    int16_t *dY;
+    int8_t *dX;
+    uint32_t *bitmap;
+    std::unique_ptr<TextMeasurer> measurer; // built on first request
+  };
+
+  struct ActiveFont
+  {
+    TFT_eSPI *tft;
+    const uint8_t *font;
+  };
+
+  const uint8_t *m_regularFont;
+  const uint8_t *m_titleFont;
+  std::vector<CachedFont> m_cache;
+  std::vector<ActiveFont> m_active;
+  FontManagerStats m_stats;
+
+  ActiveFont *findActive(TFT_eSPI *tft);
+  CachedFont *findCached(const uint8_t *font);
+  void detach(TFT_eSPI *tft);
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef FRAME_BUFFER_H
+#define FRAME_BUFFER_H
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+
+struct FrameBufferStats
+{
+  unsigned long frames;         // finished flushes
+  unsigned long composeMicros;  // drawing into the sprite
+  unsigned long transferMicros; // CPU time blocked on DMA transfers
+  unsigned long pixelsPushed;
+};
+
+/**
+ * Full-screen sprite in PSRAM that displayers draw into, flushed to the panel
+ * in row bands over DMA.
+ *
+ * SPI DMA can't read PSRAM, so each band is copied into one of two internal
+ * bounce buffers; the copy into one overlaps the transfer of the other.
+ * Falls back to drawing straight to the panel if PSRAM or DMA is unavailable.
+ */
+class FrameBuffer
+{
+public:
+  FrameBuffer(TFT_eSPI *tft);
+  ~FrameBuffer();
+
+  bool begin();
+  bool isActive() const;
+  TFT_eSPI *canvas();
+
+  void flush(const int y, const int h, const unsigned long composeStartMicros);
+  void finish();
+
+  FrameBufferStats getStats() const;
+  void debugPrintStats() const;
+
+private:
+  TFT_eSPI *m_tft;
+  TFT_eSprite m_sprite;
+  uint16_t *m_bounce[2];
+  int m_nextBounce;
+  bool m_active;
+  bool m_inTransfer;
+  FrameBufferStats m_stats;
+
+  void release();
+};
+
+#endif
@@ -3,26 +3,55 @@
 
 #include <Arduino.h>
 #include <TFT_eSPI.h>
+#include <string>
 #include <vector>
 
 #include "types/DisplayTypes.h"
 #include "frontend/BaseDisplayer.h"
+#include "frontend/FontManager.h"
 
 class RouteDisplayer : public BaseDisplayer
 {
 public:
-  RouteDisplayer(TFT_eSPI *tft, const uint8_t *fontRegular);
+  RouteDisplayer(TFT_eSPI *tft, FontManager *fonts);
 
   void setRoutes(std::vector<DisplayRoute> routes);
   virtual void cycle() override;
 
+  void setMarquee(const bool marquee);
+  bool isMarquee() const;
+  int getFramePeriod(const int pagePeriodMs) const;
+
+  static int getRegionY();
+  static int getRegionHeight();
+
 private:
+  struct RouteBadge
+  {
+    int x; // page mode: screen x; marquee: x along the strip
+    int width;
+    std::string name;
+    uint16_t lineColor;
+    uint16_t textColor;
+  };
+
   TFT_eSPI *m_tft;
-  const uint8_t *m_fontRegular;
-  int m_curStartPtr;
-  std::vector<DisplayRoute> m_displayRoutes;
+  FontManager *m_fonts;
+  bool m_marquee;
+
+  // laid out once per setRoutes
+  std::vector<std::vector<RouteBadge>> m_pages;
+  std::vector<RouteBadge> m_strip;
+  int m_stripWidth;
+
+  int m_curPage;
+  int m_marqueeOffset;
 
-  int preCalculation();
+  void layoutPages(const std::vector<DisplayRoute> &routes, const std::vector<int> &textWidths);
+  void layoutStrip(const std::vector<DisplayRoute> &routes, const std::vector<int> &textWidths);
+  void drawBadge(const RouteBadge &badge, const int x);
+  void cyclePage();
+  void cycleMarquee();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,69 @@
+#ifndef TEXT_MEASURER_H
+#define TEXT_MEASURER_H
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+struct TextMeasurerStats
+{
+  unsigned long truncations; // truncate() calls
+  unsigned long memoHits;    // answered from the memo
+};
+
+/**
+ * Pixel widths of strings in one smooth font, from a glyph advance table
+ * built once instead of a glyph lookup per character per call.
+ *
+ * Widths match TFT_eSPI::textWidth. Main thread only.
+ */
+class TextMeasurer
+{
+public:
+  TextMeasurer(const TFT_eSPI::fontMetrics &metrics,
+               const uint16_t *unicode,
+               const uint8_t *xAdvance,
+               const int8_t *dX,
+               const uint8_t *width);
+
+  int textWidth(const std::string &text);
+  size_t fitPrefix(const std::string &text, const int maxWidth);
+  std::string truncate(const std::string &text, const int maxWidth);
+
+  TextMeasurerStats getStats() const;
+
+private:
+  struct Glyph
+  {
+    bool found;
+    uint8_t advance;
+    int8_t dX;
+    uint8_t width;
+  };
+
+  static const int ASCII_FIRST = 32;
+  static const int ASCII_LAST = 126;
+
+  Glyph m_ascii[ASCII_LAST - ASCII_FIRST + 1];
+  std::unordered_map<uint16_t, Glyph> m_extended; // non-ASCII glyphs
+  int m_spaceWidth;
+  int m_ellipsisWidth;
+
+  // scratch for the string being measured
+  std::vector<int> m_prefix;   // m_prefix[i] = advance of the first i characters
+  std::vector<int> m_tail;     // width of character i when it is the last one drawn
+  std::vector<size_t> m_bytes; // byte offset where character i starts
+  int m_leadAdjust;
+
+  std::unordered_map<std::string, std::string> m_memo;
+  TextMeasurerStats m_stats;
+
+  Glyph lookup(const uint16_t code) const;
+  void layout(const std::string &text);
+  int prefixWidth(const size_t numChars) const;
+  size_t fitChars(const size_t maxChars, const int maxWidth) const;
+};
+
+#endif
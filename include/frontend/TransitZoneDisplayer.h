@@ -10,30 +10,38 @@
 #include "frontend/BaseDisplayer.h"
 #include "frontend/RouteDisplayer.h"
 #include "frontend/DeparturesDisplayer.h"
+#include "frontend/FontManager.h"
+#include "frontend/FrameBuffer.h"
 
 class TransitZoneDisplayer : public BaseDisplayer
 {
 public:
   TransitZoneDisplayer(const std::string &name,
                        TFT_eSPI *tft,
-                       const uint8_t *fontRegular,
-                       const uint8_t *fontLarge,
+                       FrameBuffer *frameBuffer,
+                       FontManager *fonts,
                        int routeRefreshPeriodMs,
                        int departuresRefreshPeriodMs);
 
   void setRoutes(const std::vector<DisplayRoute> &displayRoutes);
   void setDepartures(const std::vector<DisplayDeparture> &displayDepartures);
+  void setDepartures(std::vector<DisplayDeparture> &&displayDepartures);
+  void setRouteMarquee(const bool marquee);
   void drawInitializing();
   void drawAreYouSure();
 
   void cycle();
   void loop();
+  unsigned long msUntilNextFrame() const;
+
+  void debugPrintFrameStats() const;
 
 private:
   std::string m_name;
   TFT_eSPI *m_tft;
-  const uint8_t *m_fontRegular;
-  const uint8_t *m_fontLarge;
+  FrameBuffer *m_frameBuffer;
+  TFT_eSPI *m_canvas; // where the board is composed; the sprite or m_tft
+  FontManager *m_fonts;
   int m_routeRefreshPeriod, m_departuresRefreshPeriod;
   std::time_t m_lastRouteRefresh, m_lastDeparturesRefresh;
 
@@ -5,13 +5,12 @@
 
 #include "backend/TransitZone.h"
 #include "types/Whitelist.h"
+#include "frontend/FontManager.h"
 
 class ZoneListDisplayer
 {
 public:
-  ZoneListDisplayer(TFT_eSPI *tft,
-                    const uint8_t *fontRegular,
-                    const uint8_t *fontLarge);
+  ZoneListDisplayer(TFT_eSPI *tft, FontManager *fonts);
 
   void drawConnecting();
   void drawNoZonesFound();
@@ -19,8 +18,7 @@ public:
 
 private:
   TFT_eSPI *m_tft;
-  const uint8_t *m_fontRegular;
-  const uint8_t *m_fontLarge;
+  FontManager *m_fonts;
 };
 
 #endif
\ No newline at end of file
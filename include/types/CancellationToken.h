@@ -0,0 +1,31 @@
+#ifndef CANCELLATION_TOKEN_H
+#define CANCELLATION_TOKEN_H
+
+#include <atomic>
+
+/**
+ * Asks long-running work on another task to stop at its next safe point.
+ *
+ * The owner calls cancel(); the work polls isCancelled() between requests
+ * and waits with sleepFor(), then unwinds normally so nothing it holds leaks.
+ */
+class CancellationToken
+{
+public:
+  CancellationToken();
+
+  CancellationToken(const CancellationToken &) = delete;
+  CancellationToken &operator=(const CancellationToken &) = delete;
+
+  void cancel();
+  void reset();
+  bool isCancelled() const;
+  bool sleepFor(const unsigned long ms) const;
+
+  static const CancellationToken &none();
+
+private:
+  std::atomic<bool> m_cancelled;
+};
+
+#endif
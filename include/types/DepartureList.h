@@ -1,20 +1,33 @@
 #ifndef DEPARTURES_LIST_H
 #define DEPARTURES_LIST_H
 
+#include <memory>
 #include <vector>
-#include <map>
 #include <ctime>
 #include "types/TransitTypes.h"
 #include "types/DisplayTypes.h"
 
+/**
+ * Departures sorted by actual timestamp, keeping only the earliest numStored
+ *
+ * Stored contiguously with capacity reserved up front, so adding and merging
+ * never allocate list nodes.
+ */
 class DepartureList
 {
 public:
   DepartureList(const int numStored = -1);
+  DepartureList(const DepartureList &other);
+  DepartureList(DepartureList &&other) = default;
+  DepartureList &operator=(const DepartureList &other);
+  DepartureList &operator=(DepartureList &&other) = default;
+
+  static DepartureList merge(const std::vector<DepartureList> &lists, const int numStored);
 
   bool empty() const;
   int size() const;
-  std::vector<Departure> getDepartures() const;
+  const std::vector<Departure> &getDepartures() const;
+  bool hasSameDepartures(const DepartureList &other) const;
   std::vector<DisplayDeparture> getDisplayDepartureList(
       const std::time_t curTime,
       const int onTimeColor,
@@ -33,7 +46,10 @@ public:
 
 private:
   int m_numStored;
-  std::multimap<std::time_t, Departure> m_departures;
+  std::vector<Departure> m_departures; // sorted by actualTimestamp
+  std::vector<Departure> m_scratch;    // merge buffer, kept to reuse its capacity; never copied
+
+  bool isFull(const size_t size) const;
 
   int getDelayColor(const int delay, const bool isRealTime,
                     const int onTimeColor,
@@ -43,4 +59,7 @@ private:
                     const int delayCutoff) const;
 };
 
+// published once complete and never modified, so readers need no lock
+using DepartureListPtr = std::shared_ptr<const DepartureList>;
+
 #endif
\ No newline at end of file
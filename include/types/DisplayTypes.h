@@ -9,7 +9,7 @@ using DisplayRoute = Route;
 
 struct DisplayDeparture
 {
-  std::string agencyOnestopId;
+  InternId agencyOnestopId;
   std::string direction;
   std::string line;
   int mins;
@@ -1,6 +1,7 @@
 #ifndef ROUTE_LIST_H
 #define ROUTE_LIST_H
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -13,8 +14,9 @@ class RouteList
 public:
   RouteList() = default;
 
-  bool routeExists(const std::string &onestopId) const;
-  Route getRoute(const std::string &onestopId) const;
+  bool routeExists(const InternId onestopId) const;
+  Route getRoute(const InternId onestopId) const;
+  const Route *findRoute(const InternId onestopId) const;
   bool empty() const;
   int size() const;
   std::vector<DisplayRoute> getDisplayRouteList() const;
@@ -25,7 +27,10 @@ public:
   void debugPrintAllRoutes() const;
 
 private:
-  std::unordered_map<std::string, Route> m_routes; // unordered_map does not work
+  std::unordered_map<InternId, Route> m_routes; // unordered_map does not work
 };
 
+// immutable once built, so it can be shared between retrievers without copying
+using RouteListPtr = std::shared_ptr<const RouteList>;
+
 #endif
\ No newline at end of file
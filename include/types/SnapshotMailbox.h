@@ -0,0 +1,40 @@
+#ifndef SNAPSHOT_MAILBOX_H
+#define SNAPSHOT_MAILBOX_H
+
+#include <atomic>
+#include <memory>
+
+/**
+ * Hands the newest snapshot from producer tasks to one consumer task
+ * without locks: publishing swaps a pointer in, taking swaps it out.
+ *
+ * A snapshot published before the last one was taken replaces it. Once
+ * published, the producer must not touch the snapshot again.
+ */
+template <typename T>
+class SnapshotMailbox
+{
+public:
+  SnapshotMailbox() : m_pending{nullptr} {}
+  ~SnapshotMailbox() { delete m_pending.exchange(nullptr); }
+
+  SnapshotMailbox(const SnapshotMailbox &) = delete;
+  SnapshotMailbox &operator=(const SnapshotMailbox &) = delete;
+
+  // producers only
+  void publish(std::unique_ptr<T> snapshot)
+  {
+    delete m_pending.exchange(snapshot.release(), std::memory_order_acq_rel);
+  }
+
+  // consumer only; empty if nothing new was published
+  std::unique_ptr<T> take()
+  {
+    return std::unique_ptr<T>(m_pending.exchange(nullptr, std::memory_order_acq_rel));
+  }
+
+private:
+  std::atomic<T *> m_pending;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef STOP_LIST_H
 #define STOP_LIST_H
 
+#include <memory>
 #include <vector>
 #include <string>
 #include <unordered_map>
@@ -12,8 +13,8 @@ class StopList
 public:
   StopList();
 
-  bool stopExists(const std::string &onestopId) const;
-  Stop getStop(const std::string &onestopId) const;
+  bool stopExists(const InternId onestopId) const;
+  Stop getStop(const InternId onestopId) const;
   std::vector<Stop> getAllStops() const;
   bool empty() const;
   int size() const;
@@ -24,7 +25,10 @@ public:
   void debugPrintAllStops() const;
 
 private:
-  std::unordered_map<std::string, Stop> m_stops;
+  std::unordered_map<InternId, Stop> m_stops;
 };
 
+// immutable once built, so it can be shared between retrievers without copying
+using StopListPtr = std::shared_ptr<const StopList>;
+
 #endif
\ No newline at end of file
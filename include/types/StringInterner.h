@@ -0,0 +1,34 @@
+#ifndef STRING_INTERNER_H
+#define STRING_INTERNER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// small handle to an interned string; equal handles mean equal strings
+using InternId = uint16_t;
+
+/**
+ * Process-wide table of onestop IDs and agency IDs
+ *
+ * Each distinct string is stored once and referred to by an InternId, so
+ * comparing IDs is an integer compare. Strings are never removed, so only
+ * strings from bounded sets such as the configured zones' catalogs belong
+ * here. Thread safe.
+ */
+class StringInterner
+{
+public:
+  static const InternId EMPTY = 0; // the empty string; default for new structs
+
+  static InternId intern(const char *str);
+  static InternId intern(const std::string &str);
+  static InternId find(const char *str);
+  static const std::string &str(const InternId id);
+
+  static size_t count();
+  static size_t memoryUsage();
+  static void debugPrintStats();
+};
+
+#endif
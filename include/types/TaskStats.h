@@ -0,0 +1,30 @@
+#ifndef TASK_STATS_H
+#define TASK_STATS_H
+
+#include <Arduino.h>
+
+/**
+ * How much of the time a task spends blocked waiting for events, and how
+ * often it wakes up. Wrap each blocking wait in beginWait()/endWait().
+ */
+class TaskStats
+{
+public:
+  TaskStats();
+
+  void beginWait();
+  void endWait();
+  void reset();
+
+  float getIdlePercent() const;
+  float getWakeupsPerMinute() const;
+  void debugPrint(const char *name) const;
+
+private:
+  unsigned long m_startMs;
+  unsigned long m_waitStartMicros;
+  uint64_t m_idleMicros;
+  unsigned long m_wakeups;
+};
+
+#endif
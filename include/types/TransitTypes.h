@@ -4,18 +4,20 @@
 #include <string>
 #include <ctime>
 
+#include "types/StringInterner.h"
+
 struct Route
 {
-  std::string onestopId;
+  InternId onestopId = StringInterner::EMPTY;
   std::string name;
   int lineColor;
   int textColor;
-  std::string agencyOnestopId;
+  InternId agencyOnestopId = StringInterner::EMPTY;
 };
 
 struct Stop
 {
-  std::string onestopId;
+  InternId onestopId = StringInterner::EMPTY;
   std::string name;
 };
 
@@ -23,11 +25,11 @@ struct Departure
 {
   Route route;
   Stop stop;
-  std::string direction;
+  std::string direction; // headsign; not interned, since new ones turn up all day
   std::time_t expectedTimestamp;
   std::time_t actualTimestamp;
   bool isRealTime;
-  std::string agencyOnestopId;
+  InternId agencyOnestopId = StringInterner::EMPTY;
   int delay;
   bool isValid;
 };
@@ -5,6 +5,8 @@
 #include <unordered_set>
 #include <string>
 
+#include "types/StringInterner.h"
+
 class Whitelist
 {
 public:
@@ -17,12 +19,15 @@ public:
   void setActive(const bool active);
 
   bool inWhitelist(const std::string &item) const;
+  bool inWhitelist(const InternId item) const;
   bool isActive() const;
 
   std::string getWhiteListStr() const;
+  std::vector<std::string> getItems() const;
 
 private:
   std::unordered_set<std::string> m_whitelist;
+  std::unordered_set<InternId> m_ids; // same items, interned for integer lookups
   bool m_isActive;
 };
 
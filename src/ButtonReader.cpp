@@ -32,3 +32,11 @@ bool ButtonReader::readButton()
   m_lastState = curState;
   return res;
 }
+
+/**
+ * True while a change is still inside the debounce window, so it needs polling
+ */
+bool ButtonReader::isSettling() const
+{
+  return m_lastState != m_lastDebounceState || millis() - m_lastDebounceTime <= m_debounceDelay;
+}
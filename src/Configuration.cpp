@@ -3,6 +3,10 @@
 #include "secrets.h"
 #include "UserConfig.h"
 #include "backend/DepartureRetriever.h"
+#include "backend/RouteRetriever.h"
+#include "backend/StopRetriever.h"
+#include "backend/RequestScheduler.h"
+#include "Constants.h"
 
 #include "fonts/Overpass_Regular12.h"
 #include "fonts/Overpass_Regular16.h"
@@ -12,18 +16,42 @@ namespace
   // store 7 departures at a time
   // retrieve departures for next 100 mins (6000 s)
   // cut off departures more than 60s ago
+  // fetch up to 2 stops at once, paced by the shared request budget
+  // one stop per request
   const DepartureRetrieverConfig DEFAULT_TRANSIT_ZONE_CONFIG = {
-      7, 6000, 60};
+      7, 6000, 60, 2, 1};
+
+  // stops per request for zones with batchDepartures set; bounded so the URL stays short
+  const int BATCH_STOPS_PER_REQUEST = 10;
+
+  // keep one TLS connection open across requests instead of a handshake per call
+  const bool API_KEEP_ALIVE = true;
+
+  // parse API array elements one at a time instead of whole pages
+  const bool API_STREAMING_PARSE = true;
+
+  // requests that may go out back to back before the API quota paces them
+  const int API_REQUEST_BURST = 10;
+
+  // ask for gzip bodies; each caller keeps a 32 KB inflate window, in PSRAM when there is some
+  const bool API_GZIP = true;
 }
 
 Configuration::~Configuration()
 {
+  delete m_asyncCaller; // its workers use the callers below
   delete m_caller;
+  for (int i = 0; i < m_workerCallers.size(); i++)
+  {
+    delete m_workerCallers[i];
+  }
   for (int i = 0; i < m_zones.size(); i++)
   {
     delete m_zones[i];
   }
   delete m_zoneListDisplayer;
+  delete m_fontManager; // detaches fonts from the frame buffer's sprite first
+  delete m_frameBuffer;
 }
 
 void Configuration::init()
@@ -35,8 +63,24 @@ void Configuration::init()
   m_password = Secrets::SECRET_PASSWORD;
   m_apiKey = Secrets::SECRET_API_KEY;
 
+  // response filters; built here so no request pays for them
+  RouteRetriever::getFilter();
+  StopRetriever::getFilter();
+  DepartureRetriever::getFilter();
+
   // API caller
-  m_caller = new APICaller(m_apiKey);
+  RequestScheduler::configure(Constants::API_REQUESTS_PER_MINUTE, API_REQUEST_BURST);
+  m_caller = new APICaller(m_apiKey, API_KEEP_ALIVE, API_STREAMING_PARSE, API_GZIP);
+  // the workers get callers of their own, since the retrieval task keeps using m_caller while they fetch
+  for (int i = 0; i < DEFAULT_TRANSIT_ZONE_CONFIG.parallelism; i++)
+  {
+    m_workerCallers.push_back(new APICaller(m_apiKey, API_KEEP_ALIVE, API_STREAMING_PARSE, API_GZIP));
+  }
+  m_asyncCaller = new AsyncAPICaller(m_workerCallers);
+  m_asyncCaller->begin();
+
+  // rotate between all zones instead of picking one
+  m_lobbyMode = userLobbyMode;
 
   // whitelist
   m_whitelist.setActive(userWhiteListActive);
@@ -48,33 +92,43 @@ void Configuration::init()
   // transitzone
   for (const UserTransitZone &zone : userTransitZoneList)
   {
+    DepartureRetrieverConfig config = DEFAULT_TRANSIT_ZONE_CONFIG;
+    if (zone.batchDepartures)
+    {
+      config.stopsPerRequest = BATCH_STOPS_PER_REQUEST;
+    }
     TransitZone *z = new TransitZone(zone.name,
                                      zone.lat,
                                      zone.lon,
                                      zone.radius,
                                      m_caller,
                                      &m_timeRetriever,
-                                     DEFAULT_TRANSIT_ZONE_CONFIG);
+                                     config);
+    z->setAsyncCaller(m_asyncCaller);
     m_zones.push_back(z);
   }
 
   // fonts
-  m_regularFont = Overpass_Regular12;
-  m_titleFont = Overpass_Regular16;
+  m_fontManager = new FontManager(Overpass_Regular12, Overpass_Regular16);
+
+  // off-screen buffer for the departures board; allocated once the panel is up
+  m_frameBuffer = new FrameBuffer(&m_tft);
 
   // displayer
-  m_zoneListDisplayer = new ZoneListDisplayer(&m_tft, m_regularFont, m_titleFont);
+  m_zoneListDisplayer = new ZoneListDisplayer(&m_tft, m_fontManager);
 }
 
 std::vector<TransitZone *> Configuration::getZones() const { return m_zones; }
 TimeRetriever *Configuration::getTimeRetriever() { return &m_timeRetriever; }
 APICaller *Configuration::getCaller() const { return m_caller; }
+AsyncAPICaller *Configuration::getAsyncCaller() const { return m_asyncCaller; }
 TFT_eSPI *Configuration::getTFT() { return &m_tft; }
 ZoneListDisplayer *Configuration::getZoneListDisplayer() { return m_zoneListDisplayer; }
-const uint8_t *Configuration::getRegularFont() const { return m_regularFont; }
-const uint8_t *Configuration::getTitleFont() const { return m_titleFont; }
+FontManager *Configuration::getFontManager() const { return m_fontManager; }
+FrameBuffer *Configuration::getFrameBuffer() const { return m_frameBuffer; }
 
 const Whitelist Configuration::getWhitelist() const { return m_whitelist; }
+bool Configuration::isLobbyMode() const { return m_lobbyMode; }
 const std::string Configuration::getSSID() const { return m_ssid; }
 const std::string Configuration::getWifiPassword() const { return m_password; }
 const std::string Configuration::getAPIKey() const { return m_apiKey; }
\ No newline at end of file
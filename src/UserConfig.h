@@ -15,6 +15,9 @@
 // and then retrieves departures for **all** stops in the radius.
 // This is why it is recommended to set a smaller radius (~50-100 meters).
 // Radius units are in **meters**
+// Optionally add a fifth element, true, to fetch that zone's departures for several stops per request
+// instead of one request per stop, e.g. {"Montgomery", 37.789, -122.401, 100, true}
+// (experimental: the batched request has not been verified against the live API)
 //   Name               , Latitude , Longitude  , Radius (m)
 UserTransitZoneList userTransitZoneList = {
 
@@ -27,6 +30,10 @@ UserTransitZoneList userTransitZoneList = {
     {"Clark/Lake", 41.88567545397383, -87.63141011522981, 100}         // Chicago Loop
 };
 
+// set userLobbyMode to true to skip the selection screen and rotate between ALL zones above,
+// e.g. for a lobby display. Every zone is kept fresh in the background, on one shared request budget.
+bool userLobbyMode = false;
+
 // set userWhiteListActive to false if you don't want to use a filter (whitelist)
 // e.g. you want ALL operators to be included in the search radius provided
 // It is **highly** recommended to use a filter to avoid long initialization times
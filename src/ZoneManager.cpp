@@ -2,41 +2,81 @@
 
 #include "frontend/Filter.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <freertos/timers.h>
+
 namespace
 {
   const int DEPARTURE_DISP_REFRESH_RATE = 10000; // ms
   const int ROUTE_DISP_REFRESH_RATE = 3000;      // ms
+  const bool ROUTE_DISP_MARQUEE = false;         // scroll routes instead of paging
 
   const int DEPARTURE_API_CALL_REFRESH_PERIOD = 30000; // ms
   const int TIME_SYNC_REFRESH_PERIOD = 300000;         // ms
 
+  // with several zones, each is shown this long; zones off screen refresh less often
+  const unsigned long ZONE_ROTATE_PERIOD = 15000;           // ms
+  const unsigned long HIDDEN_ZONE_REFRESH_PERIOD = 120000; // ms
+
+  // departures fetched in the background before the zone was opened are shown
+  // straight away up to this age, and refreshed right after
+  const unsigned long WARM_DEPARTURES_MAX_AGE = 120000; // ms
+
   const int ON_TIME_COLOR = 0x00FF00;
   const int DELAYED_COLOR = 0xFF0000;
   const int EARLY_COLOR = 0xFFFF00;
   const int NO_RT_INFO_COLOR = 0xFFFFFF;
   const int DELAY_CUTOFF = 60;
+
+  // task notification bits for the retrieval task
+  const uint32_t NOTIFY_REFRESH = 1 << 0; // ask the scheduler what is due
+  const uint32_t NOTIFY_TIME_SYNC = 1 << 1;
+  const uint32_t NOTIFY_STOP = 1 << 2;
+  const uint32_t NOTIFY_FORCE_SHOWN = 1 << 3; // refresh the zone on screen now
+
+  // longer than one HTTP timeout, so the task is only force-deleted if it is truly stuck
+  const int STOP_TIMEOUT = 25000; // ms
 }
 
-ZoneManager::ZoneManager(
-    TransitZone *zone,
-    TFT_eSPI *tft,
-    TimeRetriever *timeRetriever,
-    const Whitelist &whitelist,
-    const uint8_t *fontRegular,
-    const uint8_t *fontLarge)
-    : m_zone{zone},
-      m_timeRetriever{timeRetriever},
-      m_whitelist{whitelist},
-      m_displayer{
+ZoneManager::ZoneSlot::ZoneSlot(TransitZone *zone, TFT_eSPI *tft, FrameBuffer *frameBuffer, FontManager *fonts)
+    : zone{zone},
+      displayer{
           zone->getName(),
           tft,
-          fontRegular,
-          fontLarge,
+          frameBuffer,
+          fonts,
           ROUTE_DISP_REFRESH_RATE,
           DEPARTURE_DISP_REFRESH_RATE,
       },
-      m_lastSyncedTime{0}
+      hasRoutes{false},
+      lastFormatMs{0},
+      fetchStartMs{0}
+{
+  displayer.setRouteMarquee(ROUTE_DISP_MARQUEE);
+}
+
+ZoneManager::ZoneManager(
+    const std::vector<TransitZone *> &zones,
+    TFT_eSPI *tft,
+    TimeRetriever *timeRetriever,
+    const Whitelist &whitelist,
+    FrameBuffer *frameBuffer,
+    FontManager *fonts)
+    : m_timeRetriever{timeRetriever},
+      m_whitelist{whitelist},
+      m_lastSyncedTime{0},
+      m_shownIdx{0},
+      m_lastRotateMs{0},
+      m_scheduler{static_cast<int>(zones.size()),
+                  DEPARTURE_API_CALL_REFRESH_PERIOD,
+                  HIDDEN_ZONE_REFRESH_PERIOD},
+      m_forcedIdx{-1}
 {
+  for (TransitZone *zone : zones)
+  {
+    m_slots.emplace_back(new ZoneSlot(zone, tft, frameBuffer, fonts));
+  }
 }
 
 ZoneManager::~ZoneManager()
@@ -44,6 +84,10 @@ ZoneManager::~ZoneManager()
   stop();
 }
 
+/**
+ * Shows the first zone as soon as it has departures; the rest are
+ * initialized and fetched by the retrieval task.
+ */
 void ZoneManager::init()
 {
   // Prevent creating multiple tasks if int() is called more than once.
@@ -52,35 +96,51 @@ void ZoneManager::init()
     return;
   }
 
-  m_timeRetriever->sync(); // syncs time to NTP
-  m_lastSyncedTime = millis();
-  m_displayer.drawInitializing();
+  unsigned long startMs = millis();
 
-  // if zone not initialized then get zone routes
-  if (!m_zone->isInitialized())
+  // departures land on the async workers; each list goes straight to the main task
+  for (std::unique_ptr<ZoneSlot> &slot : m_slots)
   {
-    m_zone->init(m_whitelist);
+    ZoneSlot *s = slot.get();
+    s->zone->setOnDeparturesPublished([this, s]()
+                                      { onDeparturesPublished(*s); });
   }
-  m_displayer.setRoutes(
-      Filter::modifyRoutes(m_zone->getRoutes().getDisplayRouteList()));
 
-  m_zone->callDeparturesAPI();
-  std::vector<DisplayDeparture> displayDepartureList = m_zone->getDepartures().getDisplayDepartureList(
-      m_timeRetriever->getCurTime(),
-      ON_TIME_COLOR,
-      DELAYED_COLOR,
-      EARLY_COLOR,
-      NO_RT_INFO_COLOR,
-      DELAY_CUTOFF);
+  ZoneSlot &first = shown();
+  bool warm = first.zone->isInitialized() && first.zone->hasDeparturesNewerThan(WARM_DEPARTURES_MAX_AGE);
+  if (!warm)
+  {
+    first.displayer.drawInitializing();
+  }
 
-  for (int i = 0; i < displayDepartureList.size(); i++)
+  // if zone not initialized then get zone routes
+  if (!first.zone->isInitialized())
   {
-    Filter::modifyDeparture(displayDepartureList[i]);
+    first.zone->init(m_whitelist);
+  }
+  if (!warm)
+  {
+    first.zone->callDeparturesAPI();
   }
 
-  m_displayer.setDepartures(displayDepartureList);
+  // zones the warmer or an earlier run already fetched start with what they have
+  for (int i = 0; i < m_slots.size(); i++)
+  {
+    ZoneSlot &slot = *m_slots[i];
+    if (!slot.zone->isInitialized())
+      continue;
+
+    slot.displayer.setRoutes(formatRoutes(slot.zone));
+    slot.displayer.setDepartures(formatDepartures(slot.zone));
+    slot.lastFormatMs = millis();
+    slot.hasRoutes = true;
+    m_scheduler.seed(i, slot.zone->getDeparturesFetchedMs());
+  }
+  updateSchedule();
 
   // start thread
+  m_cancel.reset();
+  m_taskExited = xSemaphoreCreateBinary();
   xTaskCreate(
       retrievalTaskRunner,       // Function to implement the task
       "DepartureRetrievalTask",  // Name of the task
@@ -90,80 +150,456 @@ void ZoneManager::init()
       &m_retrieval_thread_handle // Task handle to keep track of created task
   );
 
-  m_displayer.cycle();
+  // timers only notify the task, which sleeps until then; the timer ID says which bit to set
+  // the refresh timer is one-shot, re-armed for whenever the scheduler says the next zone is due
+  m_refreshTimer = xTimerCreate("DepartureRefresh", pdMS_TO_TICKS(DEPARTURE_API_CALL_REFRESH_PERIOD),
+                                pdFALSE, this, timerCallback);
+  m_timeSyncTimer = xTimerCreate("TimeSync", pdMS_TO_TICKS(TIME_SYNC_REFRESH_PERIOD),
+                                 pdTRUE, this, timerCallback);
+  xTimerStart(m_timeSyncTimer, 0);
+
+  // time was synced at boot; resync off the main task rather than before the first frame
+  xTaskNotify(m_retrieval_thread_handle, NOTIFY_TIME_SYNC | NOTIFY_REFRESH, eSetBits);
+
+  m_lastRotateMs = millis();
+  first.displayer.cycle();
+
+  Serial.print((first.zone->getName() + ": time to first departure ").c_str());
+  Serial.print(millis() - startMs);
+  Serial.println(warm ? " ms (warm)" : " ms (cold)");
 }
 
 void ZoneManager::mainThreadLoop()
 {
-  // displayer is shared
-  std::lock_guard<std::mutex> lock(m_displayerMtx);
-  m_displayer.loop();
+  // pick up the newest routes and departures, if the retrieval task published any
+  for (std::unique_ptr<ZoneSlot> &slot : m_slots)
+  {
+    std::unique_ptr<std::vector<DisplayRoute>> routes = slot->routesMailbox.take();
+    if (routes)
+    {
+      slot->displayer.setRoutes(*routes);
+      slot->hasRoutes = true;
+    }
+    std::unique_ptr<std::vector<DisplayDeparture>> departures = slot->departuresMailbox.take();
+    if (departures)
+    {
+      slot->displayer.setDepartures(std::move(*departures));
+      slot->lastFormatMs = millis();
+    }
+  }
+
+  // stops can go minutes between fetches, so count the minutes down here
+  ZoneSlot &slot = shown();
+  if (slot.hasRoutes && millis() - slot.lastFormatMs >= DEPARTURE_DISP_REFRESH_RATE)
+  {
+    slot.displayer.setDepartures(formatDepartures(slot.zone));
+    slot.lastFormatMs = millis();
+  }
+
+  if (m_slots.size() > 1 && millis() - m_lastRotateMs >= ZONE_ROTATE_PERIOD)
+  {
+    rotate();
+  }
+  shown().displayer.loop();
 }
 
 void ZoneManager::stop()
 {
+  // no more notifications; the task may still re-arm the refresh timer until it has exited
+  if (m_refreshTimer != NULL)
+    xTimerStop(m_refreshTimer, portMAX_DELAY);
+  if (m_timeSyncTimer != NULL)
+    xTimerStop(m_timeSyncTimer, portMAX_DELAY);
+
   if (m_retrieval_thread_handle != NULL)
   {
-    vTaskDelete(m_retrieval_thread_handle);
+    // let the task unwind so its sockets, TLS session and JSON documents are freed
+    unsigned long startMs = millis();
+    m_cancel.cancel();
+    xTaskNotify(m_retrieval_thread_handle, NOTIFY_STOP, eSetBits);
+    if (xSemaphoreTake(m_taskExited, pdMS_TO_TICKS(STOP_TIMEOUT)) == pdTRUE)
+    {
+      Serial.print("Departure retrieval task stopped in ");
+      Serial.print(millis() - startMs);
+      Serial.println(" ms.");
+    }
+    else
+    {
+      vTaskDelete(m_retrieval_thread_handle);
+      Serial.println("Departure retrieval task did not stop in time; deleted.");
+    }
     m_retrieval_thread_handle = NULL; // Set handle to NULL to indicate task is stopped.
-    Serial.println("Departure retrieval task stopped.");
   }
+
+  if (m_taskExited != NULL)
+  {
+    vSemaphoreDelete(m_taskExited);
+    m_taskExited = NULL;
+  }
+
+  // batches the task handed out may still be landing, and they call back into this
+  for (std::unique_ptr<ZoneSlot> &slot : m_slots)
+  {
+    slot->zone->cancelPendingDepartures();
+    slot->zone->setOnDeparturesPublished(nullptr);
+  }
+
+  deleteTimers();
 }
 
 void ZoneManager::drawAreYouSure()
 {
-  m_displayer.drawAreYouSure();
+  shown().displayer.drawAreYouSure();
 }
 
 void ZoneManager::cycleDisplay()
 {
-  m_displayer.cycle();
+  shown().displayer.cycle();
+}
+
+/**
+ * Fetches the zone on screen now instead of waiting for its next refresh
+ */
+void ZoneManager::requestRefresh()
+{
+  if (m_retrieval_thread_handle == NULL)
+    return;
+
+  xTaskNotify(m_retrieval_thread_handle, NOTIFY_FORCE_SHOWN, eSetBits);
+}
+
+/**
+ * How long the main loop can sleep before the display needs it
+ */
+unsigned long ZoneManager::msUntilNextFrame() const
+{
+  unsigned long waitMs = shown().displayer.msUntilNextFrame();
+  if (m_slots.size() > 1)
+  {
+    unsigned long sinceRotate = millis() - m_lastRotateMs;
+    waitMs = std::min(waitMs, sinceRotate >= ZONE_ROTATE_PERIOD ? 0 : ZONE_ROTATE_PERIOD - sinceRotate);
+  }
+  return waitMs;
+}
+
+void ZoneManager::debugPrintDisplayStats() const
+{
+  shown().displayer.debugPrintFrameStats();
+}
+
+void ZoneManager::debugPrintTaskStats() const
+{
+  m_taskStats.debugPrint("Retrieval task");
+}
+
+/**
+ * Staleness and fetch latency per zone; read without locking, so only approximate
+ */
+void ZoneManager::debugPrintZoneStats() const
+{
+  std::vector<std::string> names;
+  for (const std::unique_ptr<ZoneSlot> &slot : m_slots)
+  {
+    names.push_back(slot->zone->getName());
+  }
+  m_scheduler.debugPrint(names);
+
+  for (const std::unique_ptr<ZoneSlot> &slot : m_slots)
+  {
+    slot->zone->debugPrintRefreshStats();
+  }
 }
 
 void ZoneManager::retrievalTaskRunner(void *pvParameters)
 {
   ZoneManager *inst = static_cast<ZoneManager *>(pvParameters);
   inst->bgTaskLoop();
+
+  // inst may be deleted as soon as this is given
+  xSemaphoreGive(inst->m_taskExited);
+  vTaskDelete(NULL);
+}
+
+/**
+ * Deletes both timers and waits until no callback can run on this instance
+ *
+ * xTimerDelete only queues a command for the timer task, so a callback may
+ * still be running or due. A function pended behind the deletes runs once
+ * the timer task has got through both.
+ */
+void ZoneManager::deleteTimers()
+{
+  if (m_refreshTimer == NULL && m_timeSyncTimer == NULL)
+    return;
+
+  if (m_refreshTimer != NULL)
+    xTimerDelete(m_refreshTimer, portMAX_DELAY);
+  if (m_timeSyncTimer != NULL)
+    xTimerDelete(m_timeSyncTimer, portMAX_DELAY);
+
+  SemaphoreHandle_t drained = xSemaphoreCreateBinary();
+  if (xTimerPendFunctionCall(timerTaskDrained, drained, 0, portMAX_DELAY) == pdPASS)
+  {
+    xSemaphoreTake(drained, portMAX_DELAY);
+  }
+  vSemaphoreDelete(drained);
+
+  m_refreshTimer = NULL;
+  m_timeSyncTimer = NULL;
+}
+
+void ZoneManager::timerTaskDrained(void *semaphore, uint32_t)
+{
+  xSemaphoreGive(static_cast<SemaphoreHandle_t>(semaphore));
+}
+
+void ZoneManager::timerCallback(TimerHandle_t timer)
+{
+  ZoneManager *inst = static_cast<ZoneManager *>(pvTimerGetTimerID(timer));
+  if (inst->m_cancel.isCancelled())
+    return; // the task is stopping or gone
+
+  uint32_t bit = timer == inst->m_refreshTimer ? NOTIFY_REFRESH : NOTIFY_TIME_SYNC;
+  xTaskNotify(inst->m_retrieval_thread_handle, bit, eSetBits);
 }
 
+/**
+ * Sleeps until a timer, a rotation or requestRefresh() notifies it. Returns once stop() cancels it.
+ */
 void ZoneManager::bgTaskLoop()
 {
-  unsigned long last_retrieval_time = millis();
-  while (true)
+  m_taskStats.reset();
+  while (!m_cancel.isCancelled())
   {
-    if (millis() - last_retrieval_time >= DEPARTURE_API_CALL_REFRESH_PERIOD)
+    uint32_t events = 0;
+    m_taskStats.beginWait();
+    xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+    m_taskStats.endWait();
+
+    if (events & NOTIFY_STOP)
+      return;
+
+    if (events & NOTIFY_FORCE_SHOWN)
+    {
+      m_forcedIdx = m_shownIdx;
+      m_scheduler.force(m_forcedIdx);
+    }
+
+    if (events & (NOTIFY_REFRESH | NOTIFY_FORCE_SHOWN))
     {
-      last_retrieval_time = millis();
-
-      m_zone->callDeparturesAPI();
-      std::vector<DisplayDeparture> displayDepartureList = m_zone->getDepartures().getDisplayDepartureList(
-          m_timeRetriever->getCurTime(),
-          ON_TIME_COLOR,
-          DELAYED_COLOR,
-          EARLY_COLOR,
-          NO_RT_INFO_COLOR,
-          DELAY_CUTOFF);
-
-      for (int i = 0; i < displayDepartureList.size(); i++)
-      {
-        Filter::modifyDeparture(displayDepartureList[i]);
-      }
-      m_displayer.setDepartures(displayDepartureList);
+      runScheduledRefreshes();
     }
 
-    if (millis() - m_lastSyncedTime >= TIME_SYNC_REFRESH_PERIOD)
+    if (events & NOTIFY_TIME_SYNC)
     {
       m_lastSyncedTime = millis();
       m_timeRetriever->sync();
     }
+  }
+}
+
+/**
+ * Refreshes zones until none is due or the budget runs out, then sets the
+ * refresh timer for when the scheduler expects the next one
+ */
+void ZoneManager::runScheduledRefreshes()
+{
+  while (!m_cancel.isCancelled())
+  {
+    recordLandedFetches();
+    updateSchedule();
+
+    unsigned long waitMs;
+    int idx = m_scheduler.next(m_shownIdx, waitMs);
+    if (idx < 0)
+    {
+      // also starts the timer if it is dormant
+      xTimerChangePeriod(m_refreshTimer, pdMS_TO_TICKS(std::max(waitMs, 1UL)), 0);
+      return;
+    }
+    refreshZone(idx);
+  }
+}
+
+/**
+ * Hands the scheduler the fetches that finished on the async workers
+ */
+void ZoneManager::recordLandedFetches()
+{
+  for (int i = 0; i < m_slots.size(); i++)
+  {
+    std::unique_ptr<FetchTimes> times = m_slots[i]->fetchesMailbox.take();
+    if (times)
+    {
+      m_scheduler.recordFetch(i, times->startMs, times->finishedMs);
+    }
+  }
+}
+
+/**
+ * Tells the scheduler when each zone's stops are next due and how many requests that takes
+ */
+void ZoneManager::updateSchedule()
+{
+  for (int i = 0; i < m_slots.size(); i++)
+  {
+    TransitZone *zone = m_slots[i]->zone;
+    if (!zone->isInitialized())
+      continue;
+
+    m_scheduler.setInFlight(i, zone->hasPendingDepartures());
+
+    if (i == m_forcedIdx)
+    {
+      m_scheduler.setCost(i, zone->getDueRequestCount(true));
+    }
+    else
+    {
+      m_scheduler.setCost(i, zone->getDueRequestCount());
+      m_scheduler.setDueIn(i, zone->msUntilDeparturesDue());
+    }
+  }
+}
+
+/**
+ * Initializes the zone first if needed, then hands its due stops to the
+ * async workers without waiting for them
+ */
+void ZoneManager::refreshZone(const int idx)
+{
+  ZoneSlot &slot = *m_slots[idx];
+  unsigned long startMs = millis();
+  bool allStops = idx == m_forcedIdx;
+  if (allStops)
+  {
+    m_forcedIdx = -1;
+  }
+
+  if (!slot.zone->isInitialized())
+  {
+    slot.zone->init(m_whitelist, m_cancel);
+    if (m_cancel.isCancelled())
+      return;
+    if (!slot.zone->isInitialized())
+    {
+      // try again once it is due again rather than straight away
+      m_scheduler.recordFetch(idx, startMs, millis());
+      return;
+    }
+    m_scheduler.setCost(idx, slot.zone->getDueRequestCount(true));
+    slot.routesMailbox.publish(
+        std::unique_ptr<std::vector<DisplayRoute>>(new std::vector<DisplayRoute>(formatRoutes(slot.zone))));
+  }
+
+  // each batch is handed to the main task by onDeparturesPublished() as it lands,
+  // and the last one to land records the fetch; a fetch already pending keeps its start
+  unsigned long noFetch = 0;
+  slot.fetchStartMs.compare_exchange_strong(noFetch, startMs);
+  slot.zone->requestDepartures(m_cancel, allStops);
+  if (m_cancel.isCancelled())
+    return;
+  if (!slot.zone->hasPendingDepartures())
+  {
+    // nothing was handed out, or it has all landed already
+    unsigned long fetchStartMs = slot.fetchStartMs.exchange(0);
+    if (fetchStartMs != 0)
+    {
+      m_scheduler.recordFetch(idx, fetchStartMs, millis());
+    }
+  }
+
+  // routes and stops are older than the cache TTL; revalidate them now that departures are up
+  if (slot.zone->needsRevalidation())
+  {
+    slot.zone->revalidate(m_cancel);
+    if (m_cancel.isCancelled())
+      return;
+    m_scheduler.setCost(idx, slot.zone->getDueRequestCount(true));
+    slot.routesMailbox.publish(
+        std::unique_ptr<std::vector<DisplayRoute>>(new std::vector<DisplayRoute>(formatRoutes(slot.zone))));
+  }
+}
+
+/**
+ * Runs on whichever task published, usually an async worker
+ */
+void ZoneManager::onDeparturesPublished(ZoneSlot &slot)
+{
+  // the displayer belongs to the main task; hand the list over instead of touching it here
+  slot.departuresMailbox.publish(
+      std::unique_ptr<std::vector<DisplayDeparture>>(new std::vector<DisplayDeparture>(formatDepartures(slot.zone))));
+
+  // the zone's fetch is done once its last batch has landed
+  if (!slot.zone->hasPendingDepartures())
+  {
+    unsigned long fetchStartMs = slot.fetchStartMs.exchange(0);
+    if (fetchStartMs != 0)
+    {
+      slot.fetchesMailbox.publish(std::unique_ptr<FetchTimes>(new FetchTimes{fetchStartMs, millis()}));
+    }
+  }
+
+  // the landed stops are scheduled again; let the task re-arm its timer for them
+  if (!m_cancel.isCancelled() && m_retrieval_thread_handle != NULL)
+  {
+    xTaskNotify(m_retrieval_thread_handle, NOTIFY_REFRESH, eSetBits);
+  }
+}
 
-    vTaskDelay(pdMS_TO_TICKS(10));
+/**
+ * Shows the next zone that has routes, from what it already has
+ */
+void ZoneManager::rotate()
+{
+  m_lastRotateMs = millis();
+  for (int step = 1; step < m_slots.size(); step++)
+  {
+    int idx = (m_shownIdx + step) % m_slots.size();
+    if (!m_slots[idx]->hasRoutes)
+      continue;
+
+    m_shownIdx = idx;
+    m_slots[idx]->displayer.cycle();
+
+    // the zone on screen has a shorter refresh period
+    xTaskNotify(m_retrieval_thread_handle, NOTIFY_REFRESH, eSetBits);
+    return;
   }
 }
 
-void ZoneManager::safeSetDisplayDeps(const std::vector<DisplayDeparture> &deps)
+ZoneManager::ZoneSlot &ZoneManager::shown() const
+{
+  return *m_slots[m_shownIdx];
+}
+
+std::vector<DisplayRoute> ZoneManager::formatRoutes(const TransitZone *zone) const
+{
+  return Filter::modifyRoutes(zone->getRoutes()->getDisplayRouteList());
+}
+
+/**
+ * Display-ready departures from the zone's latest complete list
+ */
+std::vector<DisplayDeparture> ZoneManager::formatDepartures(const TransitZone *zone) const
 {
-  // displayer is shared
-  std::lock_guard<std::mutex> lock(m_displayerMtx);
-  m_displayer.setDepartures(deps);
-}
\ No newline at end of file
+  std::vector<DisplayDeparture> displayDepartureList = zone->getDepartures()->getDisplayDepartureList(
+      m_timeRetriever->getCurTime(),
+      ON_TIME_COLOR,
+      DELAYED_COLOR,
+      EARLY_COLOR,
+      NO_RT_INFO_COLOR,
+      DELAY_CUTOFF);
+
+  // cached stops are not refetched every refresh, so some departures may have left since
+  displayDepartureList.erase(std::remove_if(displayDepartureList.begin(),
+                                            displayDepartureList.end(),
+                                            [](const DisplayDeparture &dep)
+                                            { return dep.mins < 0; }),
+                             displayDepartureList.end());
+
+  for (int i = 0; i < displayDepartureList.size(); i++)
+  {
+    Filter::modifyDeparture(displayDepartureList[i]);
+  }
+  return displayDepartureList;
+}
@@ -1,6 +1,10 @@
 #include "backend/APICaller.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
 #include <string>
+#include <cctype>
 #include <ArduinoJson.h>
 #include <StreamUtils.h>
 
@@ -41,23 +45,371 @@ namespace
       "emyPxgcYxn/eR44/KJ4EBs+lVDR3veyJm+kXQ99b21/+jh5Xos1AnX5iItreGCc=\n"
       "-----END CERTIFICATE-----\n";
   const char *TRANSIT_LAND_SERVER = "api.transit.land";
-  const char *TRANSIT_LAND_KEYS[] = {"Transfer-Encoding"};
+  const char *TRANSIT_LAND_KEYS[] = {"Transfer-Encoding", "Content-Encoding", "ETag", "Last-Modified", "Retry-After"};
+  const size_t TRANSIT_LAND_KEYS_COUNT = sizeof(TRANSIT_LAND_KEYS) / sizeof(TRANSIT_LAND_KEYS[0]);
   const int TRANSIT_LAND_PORT = 443;
 
   const int HTTP_CLIENT_TIMEOUT = 20000; // ms
+  const char *META_KEY_NAME = "meta";
+
+  // endpoints whose validators are remembered at once; catalog pages of a few zones
+  const size_t MAX_VALIDATED_ENDPOINTS = 32;
 
   // const int HTTP_CODE_SUCCESS = 200;
+
+  /**
+   * Passes reads through to another stream, counting the bytes consumed
+   *
+   * Once cancelled, it reads as end of input so the parser unwinds at once.
+   */
+  class CountingStream : public Stream
+  {
+  public:
+    CountingStream(Stream &upstream, const CancellationToken &cancel)
+        : m_upstream{upstream}, m_cancel{cancel}, m_count{0} {}
+
+    int available() override { return cancelled() ? 0 : m_upstream.available(); }
+    int peek() override { return cancelled() ? -1 : m_upstream.peek(); }
+    size_t write(uint8_t) override { return 0; }
+
+    int read() override
+    {
+      if (cancelled())
+        return -1;
+      int c = m_upstream.read();
+      if (c >= 0)
+        m_count++;
+      return c;
+    }
+
+    // forwarded so the upstream timeout is used rather than Stream's default
+    size_t readBytes(char *buffer, size_t length) override
+    {
+      if (cancelled())
+        return 0;
+      size_t n = m_upstream.readBytes(buffer, length);
+      m_count += n;
+      return n;
+    }
+
+    size_t count() const { return m_count; }
+    bool cancelled() const { return m_cancel.isCancelled(); }
+
+  private:
+    Stream &m_upstream;
+    const CancellationToken &m_cancel;
+    size_t m_count;
+  };
+
+  // parse allocator blocks keep their size in front of them, and stay aligned
+  const size_t BLOCK_HEADER_SIZE = alignof(std::max_align_t);
+
+  size_t *blockHeader(void *ptr)
+  {
+    return reinterpret_cast<size_t *>(static_cast<uint8_t *>(ptr) - BLOCK_HEADER_SIZE);
+  }
+
+  void *blockData(size_t *header)
+  {
+    return reinterpret_cast<uint8_t *>(header) + BLOCK_HEADER_SIZE;
+  }
+
+  /**
+   * The URL minus its api_key parameter; meta.next links carry the key, and
+   * validators are kept, and persisted, by endpoint
+   */
+  std::string withoutApiKey(const std::string &url)
+  {
+    const std::string param = "api_key=";
+    size_t pos = url.find(param);
+    while (pos != std::string::npos && pos > 0 && url[pos - 1] != '?' && url[pos - 1] != '&')
+    {
+      pos = url.find(param, pos + 1);
+    }
+    if (pos == std::string::npos || pos == 0)
+      return url;
+
+    size_t end = url.find('&', pos);
+    if (end != std::string::npos)
+      return url.substr(0, pos) + url.substr(end + 1); // keeps the separator before it
+    return url.substr(0, pos - 1);                     // drops the separator before it
+  }
+
+  /**
+   * Response for a request abandoned because its token was cancelled
+   */
+  JsonDocument cancelledResponse()
+  {
+    JsonDocument responseDoc;
+    responseDoc[Constants::API_CALLER_STATUS_KEY] = static_cast<int>(APICallerStatus::CANCELLED);
+    return responseDoc;
+  }
+
+  /**
+   * Waits for the next character without consuming it
+   *
+   * Returns -1 on timeout or cancellation
+   */
+  int peekWait(CountingStream &stream)
+  {
+    unsigned long start = millis();
+    while (millis() - start < HTTP_CLIENT_TIMEOUT && !stream.cancelled())
+    {
+      int c = stream.peek();
+      if (c >= 0)
+        return c;
+      delay(1);
+    }
+    return -1;
+  }
+
+  /**
+   * Waits for the next non-whitespace character without consuming it
+   *
+   * Returns -1 on timeout or cancellation
+   */
+  int peekNonSpace(CountingStream &stream)
+  {
+    int c;
+    while ((c = peekWait(stream)) >= 0 && std::isspace(c))
+    {
+      stream.read();
+    }
+    return c;
+  }
+
+  /**
+   * Reads past one JSON value without parsing it
+   *
+   * Done by hand because deserializeJson reads one character past a number,
+   * which would swallow the ',' or '}' after it. A scalar ends just before
+   * its delimiter; strings, objects and arrays end at their closing character.
+   */
+  bool skipValue(CountingStream &stream)
+  {
+    int c = peekNonSpace(stream);
+    if (c < 0)
+      return false;
+
+    if (c != '"' && c != '{' && c != '[')
+    {
+      // number, true, false or null
+      while ((c = peekWait(stream)) >= 0)
+      {
+        if (c == ',' || c == '}' || c == ']' || std::isspace(c))
+          return true;
+        stream.read();
+      }
+      return false;
+    }
+
+    int depth = 0;
+    bool inString = false;
+    bool escaped = false;
+    char ch;
+    while (stream.readBytes(&ch, 1) == 1)
+    {
+      if (inString)
+      {
+        if (escaped)
+          escaped = false;
+        else if (ch == '\\')
+          escaped = true;
+        else if (ch == '"')
+        {
+          inString = false;
+          if (depth == 0)
+            return true;
+        }
+      }
+      else if (ch == '"')
+        inString = true;
+      else if (ch == '{' || ch == '[')
+        depth++;
+      else if ((ch == '}' || ch == ']') && --depth == 0)
+        return true;
+    }
+    return false;
+  }
+
+  /**
+   * Reads an object key and the colon after it
+   */
+  bool readKey(CountingStream &stream, std::string &key)
+  {
+    key.clear();
+    if (peekNonSpace(stream) != '"')
+      return false;
+    stream.read();
+
+    bool escaped = false;
+    char c;
+    while (stream.readBytes(&c, 1) == 1)
+    {
+      if (escaped)
+      {
+        key += c;
+        escaped = false;
+      }
+      else if (c == '\\')
+      {
+        escaped = true;
+      }
+      else if (c == '"')
+      {
+        return peekNonSpace(stream) == ':' && stream.read() == ':';
+      }
+      else
+      {
+        key += c;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Walks the root object of a response. Each element of the array under arrKeyName
+   * is handed to onElement as soon as it is parsed, and freed before the next one is read.
+   * The meta object is parsed into metaDoc; other keys are skipped. Element
+   * documents are allocated from allocator.
+   *
+   * Returns an error message, or nullptr on success
+   */
+  const char *streamRootObject(CountingStream &stream,
+                               const JsonDocument &filter,
+                               const std::string &arrKeyName,
+                               const APICaller::ElementCallback &onElement,
+                               const int nestingLimit,
+                               ArduinoJson::Allocator *allocator,
+                               JsonDocument &metaDoc)
+  {
+
+    if (peekNonSpace(stream) != '{')
+      return "InvalidInput";
+    stream.read();
+
+    bool arrayFound = false;
+    std::string key;
+    while (true)
+    {
+      int c = peekNonSpace(stream);
+      if (c < 0)
+        return "IncompleteInput";
+      if (c == '}')
+      {
+        stream.read();
+        break;
+      }
+      if (c == ',')
+      {
+        stream.read();
+        continue;
+      }
+      if (!readKey(stream, key))
+        return "InvalidInput";
+
+      DeserializationError error;
+      if (key == arrKeyName)
+      {
+        if (peekNonSpace(stream) != '[')
+          return "InvalidInput";
+        stream.read();
+        arrayFound = true;
+
+        JsonVariantConst elementFilter = filter[arrKeyName][0];
+        while (true)
+        {
+          c = peekNonSpace(stream);
+          if (c < 0)
+            return "IncompleteInput";
+          if (c == ']')
+          {
+            stream.read();
+            break;
+          }
+          if (c == ',')
+          {
+            stream.read();
+            continue;
+          }
+
+          // scoped to this element, so its memory is released before the next one
+          JsonDocument elementDoc(allocator);
+          error = deserializeJson(elementDoc,
+                                  stream,
+                                  DeserializationOption::Filter(elementFilter),
+                                  DeserializationOption::NestingLimit(nestingLimit));
+          if (error)
+            return error.c_str();
+
+          JsonVariantConst element = elementDoc.as<JsonVariantConst>();
+          if (!element.isNull())
+          {
+            onElement(element);
+          }
+        }
+      }
+      else if (key == META_KEY_NAME && peekNonSpace(stream) == '{')
+      {
+        error = deserializeJson(metaDoc,
+                                stream,
+                                DeserializationOption::Filter(filter[META_KEY_NAME]),
+                                DeserializationOption::NestingLimit(nestingLimit));
+      }
+      else if (!skipValue(stream))
+      {
+        return "IncompleteInput";
+      }
+
+      if (error)
+        return error.c_str();
+    }
+
+    return arrayFound ? nullptr : "ArrayNotFound";
+  }
 }
 
-APICaller::APICaller(const std::string &apiKey) : m_apiKey(apiKey)
+APICaller::APICaller(const std::string &apiKey, const bool keepAlive, const bool streaming, const bool gzip)
+    : m_apiKey(apiKey), m_keepAlive{keepAlive}, m_streaming{streaming}, m_gzip{gzip}, m_stats{}
 {
-  m_client.collectHeaders(TRANSIT_LAND_KEYS, 1);
+  m_secureClient.setCACert(TRANSIT_LAND_ROOT_CERTIFICATE);
+  m_client.collectHeaders(TRANSIT_LAND_KEYS, TRANSIT_LAND_KEYS_COUNT);
   m_client.setTimeout(HTTP_CLIENT_TIMEOUT);
+  m_client.setReuse(m_keepAlive);
 }
 
-JsonDocument APICaller::call(const std::string &endpoint, const JsonDocument &filter, const int nestingLimit, const bool attachApiKey)
+bool APICaller::isKeepAlive() const { return m_keepAlive; }
+
+void APICaller::setKeepAlive(const bool keepAlive)
 {
-  JsonDocument responseDoc;
+  m_keepAlive = keepAlive;
+  m_client.setReuse(m_keepAlive);
+  if (!m_keepAlive)
+  {
+    closeConnection();
+  }
+}
+
+bool APICaller::isStreaming() const { return m_streaming; }
+void APICaller::setStreaming(const bool streaming) { m_streaming = streaming; }
+bool APICaller::isGzip() const { return m_gzip; }
+void APICaller::setGzip(const bool gzip) { m_gzip = gzip; }
+
+APICallerStats APICaller::getStats() const { return m_stats; }
+
+JsonDocument APICaller::call(const std::string &endpoint,
+                             const JsonDocument &filter,
+                             const int nestingLimit,
+                             const bool attachApiKey,
+                             const CancellationToken &cancel,
+                             const CacheValidation validation)
+{
+  if (cancel.isCancelled())
+  {
+    return cancelledResponse();
+  }
+
+  JsonDocument responseDoc(&m_parseAllocator); // counted while the body is parsed into it
 
   std::string endpointToCall = endpoint;
   if (attachApiKey)
@@ -65,36 +417,58 @@ JsonDocument APICaller::call(const std::string &endpoint, const JsonDocument &fi
     endpointToCall += "&api_key=" + m_apiKey;
   }
 
-  // setup client
-  m_client.begin(TRANSIT_LAND_SERVER,
-                 TRANSIT_LAND_PORT,
-                 endpointToCall.c_str(),
-                 TRANSIT_LAND_ROOT_CERTIFICATE);
-
   // check HTTP code
-  int httpCode = m_client.GET(); // makes request and retrieves HTTP code
-  if (httpCode != HTTP_CODE_OK)
+  const Validators *validators = findValidators(endpoint, validation);
+  int httpCode = sendRequest(endpointToCall, validators); // makes request and retrieves HTTP code
+  if (validators != nullptr && httpCode == HTTP_CODE_NOT_MODIFIED)
   {
+    // a 304 has no body, so the connection stays usable
     m_client.end();
-
-    responseDoc[Constants::API_CALLER_STATUS_KEY] = static_cast<int>(APICallerStatus::HTTP_ERROR);
-    responseDoc[Constants::API_HTTP_STATUS_KEY] = httpCode;
-
-    return responseDoc;
+    return notModifiedResponse(*validators);
+  }
+  if (httpCode != HTTP_CODE_OK)
+  {
+    // body was not read, so the connection can't be reused
+    return httpErrorResponse(httpCode);
   }
 
   // stream response from TransitLand API
   Stream &rawStream = m_client.getStream();
   ChunkDecodingStream decodedStream(m_client.getStream());
   // Choose the right stream depending on the Transfer-Encoding header
-  Stream &response =
+  Stream &decoded =
       m_client.header("Transfer-Encoding") == "chunked" ? decodedStream : rawStream;
+  bool gzipped;
+  Stream *body = openBody(decoded, gzipped);
+  if (body == nullptr)
+  {
+    m_client.end();
+    closeConnection();
+    responseDoc[Constants::API_CALLER_STATUS_KEY] = static_cast<int>(APICallerStatus::DESERIALIZE_ERROR);
+    responseDoc[Constants::API_DESERIALIZE_ERROR_KEY] = "InflateFailed";
+    responseDoc[Constants::API_HTTP_STATUS_KEY] = httpCode;
+    return responseDoc;
+  }
+  CountingStream response(*body, cancel);
 
   // load JSON from stream
+  unsigned long parseStart = micros();
+  m_parseAllocator.beginParse();
   DeserializationError error = deserializeJson(responseDoc,
                                                response,
                                                DeserializationOption::Filter(filter),
                                                DeserializationOption::NestingLimit(nestingLimit));
+  recordParse(parseStart);
+  bool parsed = !error && !response.cancelled();
+  size_t bodyBytes = closeBody(gzipped, response.count(), parsed);
+
+  if (response.cancelled())
+  {
+    // rest of the body is unread
+    m_client.end();
+    closeConnection();
+    return cancelledResponse();
+  }
 
   // deserialize error
   if (error)
@@ -106,11 +480,435 @@ JsonDocument APICaller::call(const std::string &endpoint, const JsonDocument &fi
   else
   {
     responseDoc[Constants::API_CALLER_STATUS_KEY] = static_cast<int>(APICallerStatus::STATUS_OK);
+    if (validation != CacheValidation::OFF)
+    {
+      rememberValidators(endpoint, responseDoc[META_KEY_NAME]["next"], bodyBytes);
+    }
   }
   responseDoc[Constants::API_HTTP_STATUS_KEY] = httpCode; // do this here because deserializeJson clears input
 
   // end client
+  // with keep-alive, the connection stays open unless the server asked to close it
+  m_client.end();
+  if (error)
+  {
+    // unread body would corrupt the next response on this connection
+    closeConnection();
+  }
+
+  return responseDoc;
+}
+
+/**
+ * Like call(), but never holds the whole page in memory.
+ *
+ * Each element of the array under arrKeyName is passed to onElement as soon as it is parsed.
+ * The returned document only holds the status keys and the "meta" object.
+ */
+JsonDocument APICaller::callStreaming(const std::string &endpoint,
+                                      const JsonDocument &filter,
+                                      const std::string &arrKeyName,
+                                      const ElementCallback &onElement,
+                                      const int nestingLimit,
+                                      const bool attachApiKey,
+                                      const CancellationToken &cancel,
+                                      const CacheValidation validation)
+{
+  if (cancel.isCancelled())
+  {
+    return cancelledResponse();
+  }
+
+  JsonDocument responseDoc;
+
+  std::string endpointToCall = endpoint;
+  if (attachApiKey)
+  {
+    endpointToCall += "&api_key=" + m_apiKey;
+  }
+
+  const Validators *validators = findValidators(endpoint, validation);
+  int httpCode = sendRequest(endpointToCall, validators);
+  if (validators != nullptr && httpCode == HTTP_CODE_NOT_MODIFIED)
+  {
+    m_client.end();
+    return notModifiedResponse(*validators);
+  }
+  if (httpCode != HTTP_CODE_OK)
+  {
+    return httpErrorResponse(httpCode);
+  }
+
+  Stream &rawStream = m_client.getStream();
+  ChunkDecodingStream decodedStream(m_client.getStream());
+  Stream &decoded =
+      m_client.header("Transfer-Encoding") == "chunked" ? decodedStream : rawStream;
+  bool gzipped;
+  Stream *body = openBody(decoded, gzipped);
+  if (body == nullptr)
+  {
+    m_client.end();
+    closeConnection();
+    responseDoc[Constants::API_CALLER_STATUS_KEY] = static_cast<int>(APICallerStatus::DESERIALIZE_ERROR);
+    responseDoc[Constants::API_DESERIALIZE_ERROR_KEY] = "InflateFailed";
+    responseDoc[Constants::API_HTTP_STATUS_KEY] = httpCode;
+    return responseDoc;
+  }
+  CountingStream response(*body, cancel);
+  response.setTimeout(HTTP_CLIENT_TIMEOUT);
+
+  unsigned long parseStart = micros();
+  m_parseAllocator.beginParse();
+  JsonDocument metaDoc(&m_parseAllocator);
+  const char *error = streamRootObject(
+      response, filter, arrKeyName, onElement, nestingLimit, &m_parseAllocator, metaDoc);
+  recordParse(parseStart);
+  size_t bodyBytes = closeBody(gzipped, response.count(), error == nullptr && !response.cancelled());
+
+  if (response.cancelled())
+  {
+    m_client.end();
+    closeConnection();
+    return cancelledResponse();
+  }
+
+  if (error)
+  {
+    responseDoc[Constants::API_CALLER_STATUS_KEY] = static_cast<int>(APICallerStatus::DESERIALIZE_ERROR);
+    responseDoc[Constants::API_DESERIALIZE_ERROR_KEY] = error;
+  }
+  else
+  {
+    responseDoc[Constants::API_CALLER_STATUS_KEY] = static_cast<int>(APICallerStatus::STATUS_OK);
+    if (!metaDoc.isNull())
+    {
+      responseDoc[META_KEY_NAME] = metaDoc;
+    }
+    if (validation != CacheValidation::OFF)
+    {
+      rememberValidators(endpoint, metaDoc["next"], bodyBytes);
+    }
+  }
+  responseDoc[Constants::API_HTTP_STATUS_KEY] = httpCode;
+
   m_client.end();
+  if (error)
+  {
+    closeConnection();
+  }
 
   return responseDoc;
-}
\ No newline at end of file
+}
+
+void APICaller::debugPrintStats() const
+{
+  Serial.println(F("--- API Caller Stats ---"));
+  Serial.print(F("Keep-alive: "));
+  Serial.println(m_keepAlive ? "On" : "Off");
+  Serial.print(F("Requests: "));
+  Serial.println(m_stats.requests);
+  Serial.print(F("TLS handshakes: "));
+  Serial.println(m_stats.handshakes);
+  Serial.print(F("Reused connections: "));
+  Serial.println(m_stats.reusedRequests);
+  Serial.print(F("Reconnects: "));
+  Serial.println(m_stats.reconnects);
+  Serial.print(F("Bytes received: "));
+  Serial.println(m_stats.bytesReceived);
+  Serial.print(F("Parse mode: "));
+  Serial.println(m_streaming ? "Streaming" : "Document");
+  Serial.print(F("Parse throughput (bytes/s): "));
+  Serial.println(m_stats.parseMicros == 0 ? 0ULL : 1000000ULL * m_stats.bytesReceived / m_stats.parseMicros);
+  Serial.print(F("Peak parse heap (bytes): "));
+  Serial.println(m_stats.peakParseHeap);
+  Serial.print(F("Not modified (304): "));
+  Serial.println(m_stats.notModified);
+  Serial.print(F("Bytes saved by 304s: "));
+  Serial.println(m_stats.bytesSaved);
+  Serial.print(F("Validated endpoints: "));
+  Serial.println(m_validators.size());
+  Serial.print(F("Gzip: "));
+  Serial.println(m_gzip ? "On" : "Off");
+  Serial.print(F("Gzip responses: "));
+  Serial.println(m_stats.gzipResponses);
+  Serial.print(F("Bytes inflated: "));
+  Serial.println(m_stats.bytesInflated);
+}
+
+/**
+ * Sends a GET request, reusing the open connection if keep-alive is on
+ *
+ * If the server dropped a kept-alive connection, it is re-established once.
+ * With validators, the request is conditional and may be answered 304.
+ */
+int APICaller::sendRequest(const std::string &endpoint, const Validators *validators)
+{
+  bool reusing = m_keepAlive && m_secureClient.connected();
+
+  // begin() clears request headers, so they are added after it every time
+  auto beginRequest = [&]()
+  {
+    m_client.begin(m_secureClient, TRANSIT_LAND_SERVER, TRANSIT_LAND_PORT, endpoint.c_str(), true);
+    if (m_gzip)
+      m_client.addHeader("Accept-Encoding", "gzip");
+    if (validators == nullptr)
+      return;
+    if (!validators->etag.empty())
+      m_client.addHeader("If-None-Match", validators->etag.c_str());
+    if (!validators->lastModified.empty())
+      m_client.addHeader("If-Modified-Since", validators->lastModified.c_str());
+  };
+
+  beginRequest();
+  int httpCode = m_client.GET();
+
+  // negative codes are transport errors; a timeout means the server is slow, not gone
+  if (reusing && httpCode < 0 && httpCode != HTTPC_ERROR_READ_TIMEOUT)
+  {
+    m_stats.reconnects++;
+    m_client.end();
+    closeConnection();
+
+    reusing = false;
+    beginRequest();
+    httpCode = m_client.GET();
+  }
+
+  m_stats.requests++;
+  if (reusing)
+  {
+    m_stats.reusedRequests++;
+  }
+  else
+  {
+    m_stats.handshakes++;
+  }
+
+  return httpCode;
+}
+
+/**
+ * Ends a request whose body was not read, so the connection can't be reused
+ *
+ * A Retry-After given in seconds is passed on under API_RETRY_AFTER_KEY.
+ */
+JsonDocument APICaller::httpErrorResponse(const int httpCode)
+{
+  JsonDocument responseDoc;
+  responseDoc[Constants::API_CALLER_STATUS_KEY] = static_cast<int>(APICallerStatus::HTTP_ERROR);
+  responseDoc[Constants::API_HTTP_STATUS_KEY] = httpCode;
+  if (httpCode > 0)
+  {
+    long retryAfter = m_client.header("Retry-After").toInt(); // 0 for an HTTP date
+    if (retryAfter > 0)
+    {
+      responseDoc[Constants::API_RETRY_AFTER_KEY] = retryAfter;
+    }
+  }
+
+  m_client.end();
+  closeConnection();
+  return responseDoc;
+}
+
+/**
+ * The stream to parse the body from: decoded itself, or an inflating view of it
+ * for a gzip body. nullptr if the gzip body could not be opened.
+ */
+Stream *APICaller::openBody(Stream &decoded, bool &gzipped)
+{
+  gzipped = m_client.header("Content-Encoding") == "gzip";
+  if (!gzipped)
+    return &decoded;
+
+  m_inflate.setTimeout(HTTP_CLIENT_TIMEOUT);
+  if (!m_inflate.begin(decoded))
+  {
+    m_inflate.end();
+    return nullptr;
+  }
+  return &m_inflate;
+}
+
+/**
+ * Records the body's size and returns how many bytes it took on the wire
+ *
+ * A parsed gzip body is inflated to its end, so the trailer is not left on
+ * a kept-alive connection; if that fails, the connection is closed.
+ */
+size_t APICaller::closeBody(const bool gzipped, const size_t readBytes, const bool parsed)
+{
+  if (!gzipped)
+  {
+    m_stats.bytesReceived += readBytes;
+    return readBytes;
+  }
+
+  if (parsed && !m_inflate.finish())
+  {
+    closeConnection();
+  }
+  size_t wireBytes = m_inflate.compressedCount();
+  m_stats.gzipResponses++;
+  m_stats.bytesReceived += wireBytes;
+  m_stats.bytesInflated += m_inflate.inflatedCount();
+  m_inflate.end();
+  return wireBytes;
+}
+
+/**
+ * The remembered validators of those endpoints, for persisting alongside what they validate
+ */
+APICaller::ValidatorMap APICaller::exportValidators(const std::vector<std::string> &endpoints) const
+{
+  ValidatorMap res;
+  for (const std::string &endpoint : endpoints)
+  {
+    auto it = m_validators.find(withoutApiKey(endpoint));
+    if (it != m_validators.end())
+      res.insert(*it);
+  }
+  return res;
+}
+
+/**
+ * Remembers validators exported earlier, so the next REVALIDATE request can be answered 304
+ */
+void APICaller::importValidators(const ValidatorMap &validators)
+{
+  for (const auto &entry : validators)
+  {
+    if (m_validators.size() >= MAX_VALIDATED_ENDPOINTS && m_validators.count(entry.first) == 0)
+    {
+      m_validators.erase(m_validators.begin());
+    }
+    m_validators[entry.first] = entry.second;
+  }
+}
+
+/**
+ * Validators to send with a request to endpoint, or nullptr for an unconditional request
+ */
+const APICaller::Validators *APICaller::findValidators(const std::string &endpoint,
+                                                       const CacheValidation validation) const
+{
+  if (validation != CacheValidation::REVALIDATE)
+    return nullptr;
+  auto it = m_validators.find(withoutApiKey(endpoint));
+  return it == m_validators.end() ? nullptr : &it->second;
+}
+
+/**
+ * Keeps the validators of the response just read, along with what a later 304 must stand in for
+ */
+void APICaller::rememberValidators(const std::string &pageEndpoint, JsonVariantConst next, const size_t bodyBytes)
+{
+  // never keep the API key, since the validators may be written to flash
+  std::string endpoint = withoutApiKey(pageEndpoint);
+  String etag = m_client.header("ETag");
+  String lastModified = m_client.header("Last-Modified");
+  if (etag.length() == 0 && lastModified.length() == 0)
+  {
+    m_validators.erase(endpoint);
+    return;
+  }
+
+  if (m_validators.size() >= MAX_VALIDATED_ENDPOINTS && m_validators.count(endpoint) == 0)
+  {
+    m_validators.erase(m_validators.begin());
+  }
+
+  Validators &validators = m_validators[endpoint];
+  validators.etag = etag.c_str();
+  validators.lastModified = lastModified.c_str();
+  validators.next = next.is<const char *>() ? withoutApiKey(next.as<const char *>()) : "";
+  validators.bodyBytes = bodyBytes;
+}
+
+/**
+ * Response for a 304; carries the remembered next page so pagination carries on
+ */
+JsonDocument APICaller::notModifiedResponse(const Validators &validators)
+{
+  m_stats.notModified++;
+  m_stats.bytesSaved += validators.bodyBytes;
+
+  JsonDocument responseDoc;
+  responseDoc[Constants::API_CALLER_STATUS_KEY] = static_cast<int>(APICallerStatus::NOT_MODIFIED);
+  responseDoc[Constants::API_HTTP_STATUS_KEY] = HTTP_CODE_NOT_MODIFIED;
+  if (!validators.next.empty())
+  {
+    // the next page is requested as is, so it needs the key the real meta.next had
+    char separator = validators.next.find('?') == std::string::npos ? '?' : '&';
+    responseDoc[META_KEY_NAME]["next"] = validators.next + separator + "api_key=" + m_apiKey;
+  }
+  return responseDoc;
+}
+
+void APICaller::recordParse(const unsigned long startMicros)
+{
+  m_stats.parseMicros += micros() - startMicros;
+  m_stats.peakParseHeap = std::max<unsigned long>(m_stats.peakParseHeap, m_parseAllocator.parsePeak());
+}
+
+void *APICaller::ParseAllocator::allocate(size_t size)
+{
+  size_t *header = static_cast<size_t *>(malloc(BLOCK_HEADER_SIZE + size));
+  if (header == nullptr)
+    return nullptr;
+  *header = size;
+  add(size);
+  return blockData(header);
+}
+
+void APICaller::ParseAllocator::deallocate(void *ptr)
+{
+  if (ptr == nullptr)
+    return;
+  size_t *header = blockHeader(ptr);
+  m_held -= *header;
+  free(header);
+}
+
+void *APICaller::ParseAllocator::reallocate(void *ptr, size_t newSize)
+{
+  if (ptr == nullptr)
+    return allocate(newSize);
+
+  size_t oldSize = *blockHeader(ptr);
+  size_t *header = static_cast<size_t *>(realloc(blockHeader(ptr), BLOCK_HEADER_SIZE + newSize));
+  if (header == nullptr)
+    return nullptr;
+  *header = newSize;
+  m_held -= oldSize;
+  add(newSize);
+  return blockData(header);
+}
+
+/**
+ * Starts measuring from what documents already hold
+ */
+void APICaller::ParseAllocator::beginParse()
+{
+  m_start = m_held;
+  m_peak = m_start;
+}
+
+/**
+ * Most the documents held at once since beginParse(), beyond what they held then
+ */
+size_t APICaller::ParseAllocator::parsePeak() const
+{
+  return m_peak - m_start;
+}
+
+void APICaller::ParseAllocator::add(const size_t size)
+{
+  m_held += size;
+  m_peak = std::max(m_peak, m_held.load());
+}
+
+void APICaller::closeConnection()
+{
+  m_secureClient.stop();
+}
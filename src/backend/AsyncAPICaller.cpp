@@ -0,0 +1,167 @@
+#include "backend/AsyncAPICaller.h"
+
+#include <Arduino.h>
+
+namespace
+{
+  const int WORKER_STACK_SIZE = 8192;
+  const int WORKER_PRIORITY = 1;
+  const UBaseType_t MAX_QUEUED = 0xFFFF; // jobs; the queue is effectively unbounded
+}
+
+AsyncRequest::AsyncRequest(const AsyncJob &job, const AsyncCompletion &onDone)
+    : m_job{job}, m_onDone{onDone}, m_done{xSemaphoreCreateBinary()}, m_finished{false}, m_ok{false} {}
+
+AsyncRequest::~AsyncRequest()
+{
+  vSemaphoreDelete(m_done);
+}
+
+/**
+ * Blocks until the job has run and returns its result; may be called again
+ */
+bool AsyncRequest::wait()
+{
+  if (!m_finished)
+  {
+    xSemaphoreTake(m_done, portMAX_DELAY);
+    xSemaphoreGive(m_done); // for the next wait()
+  }
+  return m_ok;
+}
+
+bool AsyncRequest::isDone() const { return m_finished; }
+
+void AsyncRequest::run(APICaller *caller)
+{
+  m_ok = m_job(caller);
+  if (m_onDone)
+  {
+    m_onDone(m_ok);
+  }
+  m_finished = true;
+  xSemaphoreGive(m_done);
+}
+
+AsyncAPICaller::AsyncAPICaller(const std::vector<APICaller *> &callers)
+    : m_callers{callers}, m_queued{xSemaphoreCreateCounting(MAX_QUEUED, 0)},
+      m_inFlight{0}, m_peakInFlight{0}, m_completed{0} {}
+
+/**
+ * Only safe once every job has completed
+ */
+AsyncAPICaller::~AsyncAPICaller()
+{
+  for (Worker &worker : m_workers)
+  {
+    vTaskDelete(worker.handle);
+  }
+  vSemaphoreDelete(m_queued);
+}
+
+/**
+ * Starts one worker per caller. Returns false if none could be started;
+ * jobs then run on the submitting task instead.
+ */
+bool AsyncAPICaller::begin()
+{
+  if (!m_workers.empty())
+    return true;
+
+  // reserved up front so the workers' pointers into it stay valid
+  m_workers.reserve(m_callers.size());
+  for (APICaller *caller : m_callers)
+  {
+    m_workers.push_back({this, caller, NULL});
+    if (xTaskCreate(workerTaskRunner,
+                    "APIWorker",
+                    WORKER_STACK_SIZE,
+                    &m_workers.back(),
+                    WORKER_PRIORITY,
+                    &m_workers.back().handle) != pdPASS)
+    {
+      m_workers.pop_back();
+      break;
+    }
+  }
+
+  if (m_workers.empty())
+  {
+    Serial.println(F("Async API caller: no workers, running jobs inline"));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Queues a job for the next free worker and returns straight away
+ */
+AsyncRequestPtr AsyncAPICaller::submit(const AsyncJob &job, const AsyncCompletion &onDone)
+{
+  AsyncRequestPtr request = std::make_shared<AsyncRequest>(job, onDone);
+
+  int inFlight = ++m_inFlight;
+  int peak = m_peakInFlight;
+  while (inFlight > peak && !m_peakInFlight.compare_exchange_weak(peak, inFlight))
+  {
+  }
+
+  if (m_workers.empty())
+  {
+    // no workers; run it here rather than drop it
+    request->run(m_callers.empty() ? nullptr : m_callers.front());
+    m_inFlight--;
+    m_completed++;
+    return request;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_queueMtx);
+    m_queue.push_back(request);
+  }
+  xSemaphoreGive(m_queued);
+  return request;
+}
+
+int AsyncAPICaller::getWorkerCount() const { return m_workers.size(); }
+int AsyncAPICaller::getInFlight() const { return m_inFlight; }
+
+void AsyncAPICaller::debugPrintStats() const
+{
+  Serial.println(F("--- Async API Caller ---"));
+  Serial.print(F("Workers: "));
+  Serial.println(m_workers.size());
+  Serial.print(F("In flight: "));
+  Serial.println(static_cast<int>(m_inFlight));
+  Serial.print(F("Peak in flight: "));
+  Serial.println(static_cast<int>(m_peakInFlight));
+  Serial.print(F("Completed: "));
+  Serial.println(static_cast<unsigned long>(m_completed));
+}
+
+void AsyncAPICaller::workerTaskRunner(void *pvParameters)
+{
+  Worker *worker = static_cast<Worker *>(pvParameters);
+  worker->inst->workerLoop(worker->caller);
+}
+
+void AsyncAPICaller::workerLoop(APICaller *caller)
+{
+  while (true)
+  {
+    xSemaphoreTake(m_queued, portMAX_DELAY);
+
+    AsyncRequestPtr request;
+    {
+      std::lock_guard<std::mutex> lock(m_queueMtx);
+      if (m_queue.empty())
+        continue;
+      request = m_queue.front();
+      m_queue.pop_front();
+    }
+
+    request->run(caller);
+    m_inFlight--;
+    m_completed++;
+  }
+}
@@ -5,55 +5,182 @@
 #include <ArduinoJson.h>
 
 #include "backend/APICaller.h"
+#include "backend/RequestScheduler.h"
 #include "Constants.h"
 
 namespace
 {
-  const int RETRY_DELAY = 10000; // ms
-  const int PING_DELAY = 1000;   // ms
+  const int MAX_RETRIES = 4; // per page, for timeouts, dropped connections, 429s and 5xx
   const char *TRANSIT_LAND_URL_PREFIX = "https://transit.land";
+
+  /**
+   * Failures that may well succeed if sent again; nothing was parsed for them
+   */
+  bool isTransient(const int httpCode)
+  {
+    return httpCode < 0 || httpCode == HTTP_CODE_TOO_MANY_REQUESTS || httpCode >= 500;
+  }
 }
 
 BaseRetriever::BaseRetriever(
     APICaller *caller, const std::string &endpoint, const int maxPages, const int errorPin)
-    : m_caller{caller}, m_endpoint{endpoint}, m_maxPages{maxPages}, m_errorPin{errorPin} {}
+    : m_caller{caller}, m_endpoint{endpoint}, m_maxPages{maxPages}, m_errorPin{errorPin},
+      m_cancel{&CancellationToken::none()}, m_validation{CacheValidation::OFF}, m_unchanged{false},
+      m_requests{0} {}
 
 std::string BaseRetriever::getEndpoint() const { return m_endpoint; }
 void BaseRetriever::setEndpoint(const std::string &endpoint) { m_endpoint = endpoint; }
 
+/**
+ * Once cancelled, retrieve() stops between requests and returns false
+ */
+void BaseRetriever::setCancellationToken(const CancellationToken &cancel) { m_cancel = &cancel; }
+
+/**
+ * Only for retrievers whose parse is idempotent, since a catalog that
+ * changed partway through is parsed again from the first page
+ */
+void BaseRetriever::setCacheValidation(const CacheValidation validation) { m_validation = validation; }
+
+/**
+ * Whether every page of the last retrieve() answered 304. Nothing was
+ * parsed then; the caller's previous results still hold.
+ */
+bool BaseRetriever::isUnchanged() const { return m_unchanged; }
+
+/**
+ * Every page the last retrieve() requested, as passed to the caller
+ */
+std::vector<std::string> BaseRetriever::getPageEndpoints() const { return m_pageEndpoints; }
+
+/**
+ * HTTP requests the last retrieve() sent: every page, retry and refetch
+ */
+int BaseRetriever::getRequestCount() const { return m_requests; }
+
 bool BaseRetriever::loopRequest(
     const JsonDocument &filter, const std::string &arrKeyName, const int nestingLimit)
+{
+  m_unchanged = false;
+  m_requests = 0;
+  int pages = 0;
+  int notModifiedPages = 0;
+  bool res = requestPages(filter, arrKeyName, nestingLimit, m_validation, pages, notModifiedPages);
+  if (!res || notModifiedPages == 0)
+    return res;
+
+  if (notModifiedPages == pages)
+  {
+    m_unchanged = true;
+    return true;
+  }
+
+  // a later page changed after earlier ones did not, so those were never parsed
+  Serial.println(("Changed partway, fetching again: " + m_endpoint).c_str());
+  pages = 0;
+  notModifiedPages = 0;
+  return requestPages(filter, arrKeyName, nestingLimit, CacheValidation::RECORD, pages, notModifiedPages);
+}
+
+/**
+ * Fetches and parses every page. Pages answered 304 are counted in
+ * notModifiedPages and not parsed.
+ */
+bool BaseRetriever::requestPages(const JsonDocument &filter,
+                                 const std::string &arrKeyName,
+                                 const int nestingLimit,
+                                 CacheValidation validation,
+                                 int &pages,
+                                 int &notModifiedPages)
 {
   int loopCnt = 0;
+  int attempt = 0; // of the current page
   std::string curEndpoint = m_endpoint;
+  m_pageEndpoints.clear();
   while (curEndpoint.length() > 0 && loopCnt < m_maxPages)
   {
+    if (m_cancel->isCancelled())
+      return false;
+
+    // every request, from any task, is paced by the shared budget
+    if (!RequestScheduler::acquire(*m_cancel))
+      return false;
+    m_requests++;
+
     writePinIfExists(LOW);
+    if (attempt == 0)
+      m_pageEndpoints.push_back(curEndpoint);
 
     // fetch API
     // next page attaches API key, so don't attach if our loopCnt is > 0
     bool attachApiKey = loopCnt == 0;
-    JsonDocument responseDoc = m_caller->call(curEndpoint, filter, nestingLimit, attachApiKey);
+    bool streaming = m_caller->isStreaming();
+    JsonDocument responseDoc;
+    if (streaming)
+    {
+      // elements are parsed as they arrive, so the page is never held in memory
+      responseDoc = m_caller->callStreaming(
+          curEndpoint, filter, arrKeyName,
+          [this](JsonVariantConst &elementDoc)
+          { parseOneElement(elementDoc); },
+          nestingLimit, attachApiKey, *m_cancel, validation);
+    }
+    else
+    {
+      responseDoc = m_caller->call(curEndpoint, filter, nestingLimit, attachApiKey, *m_cancel, validation);
+    }
+
+    // abandoned on purpose; not an error
+    if (responseDoc[Constants::API_CALLER_STATUS_KEY] == static_cast<int>(APICallerStatus::CANCELLED))
+    {
+      return false;
+    }
+
+    // same as last time; the next page is carried over from then
+    bool notModified =
+        responseDoc[Constants::API_CALLER_STATUS_KEY] == static_cast<int>(APICallerStatus::NOT_MODIFIED);
+    if (notModified)
+    {
+      notModifiedPages++;
+    }
+    else if (validation == CacheValidation::REVALIDATE &&
+             responseDoc[Constants::API_CALLER_STATUS_KEY] == static_cast<int>(APICallerStatus::STATUS_OK))
+    {
+      // once a page has changed, every later page has to be parsed anyway
+      validation = CacheValidation::RECORD;
+    }
 
     // print error, if any, and fail
-    if (responseDoc[Constants::API_CALLER_STATUS_KEY] != static_cast<int>(APICallerStatus::STATUS_OK))
+    if (!notModified &&
+        responseDoc[Constants::API_CALLER_STATUS_KEY] != static_cast<int>(APICallerStatus::STATUS_OK))
     {
       writePinIfExists(HIGH);
 
       int httpCode = responseDoc[Constants::API_HTTP_STATUS_KEY];
-
-      // retry in 10 seconds if read timeout
-      if (httpCode == HTTPC_ERROR_READ_TIMEOUT)
-      {
-        Serial.println(" (Timeout). Retrying...");
-        delay(RETRY_DELAY);
-        continue;
-      }
+      bool isHttpError =
+          responseDoc[Constants::API_CALLER_STATUS_KEY] == static_cast<int>(APICallerStatus::HTTP_ERROR);
 
       // activate rate limiting pin if we are rate limited
+      // and hold back every task until the server says to try again
       if (httpCode == HTTP_CODE_TOO_MANY_REQUESTS)
       {
         digitalWrite(Constants::RATE_LIMIT_PIN, HIGH);
+        RequestScheduler::recordRateLimited();
+        unsigned long retryAfterMs = responseDoc[Constants::API_RETRY_AFTER_KEY].as<unsigned long>() * 1000UL;
+        RequestScheduler::pauseFor(retryAfterMs > 0 ? retryAfterMs : RequestScheduler::backoffMs(attempt));
+      }
+
+      // retry with backoff; the 429 pause is waited out in acquire()
+      if (isHttpError && isTransient(httpCode) && attempt < MAX_RETRIES)
+      {
+        Serial.print(" (HTTP ");
+        Serial.print(httpCode);
+        Serial.println("). Retrying...");
+        if (httpCode != HTTP_CODE_TOO_MANY_REQUESTS && !m_cancel->sleepFor(RequestScheduler::backoffMs(attempt)))
+          return false;
+        RequestScheduler::recordRetry();
+        attempt++;
+        continue;
       }
 
       Serial.println(("Endpoint failed: " + m_endpoint).c_str());
@@ -62,6 +189,8 @@ bool BaseRetriever::loopRequest(
       return false;
     }
 
+    attempt = 0;
+
     // retrieve next page
     if (responseDoc["meta"].isNull() || !responseDoc["meta"]["next"].is<const char *>())
     {
@@ -73,6 +202,13 @@ bool BaseRetriever::loopRequest(
       curEndpoint = curEndpoint.substr(strlen(TRANSIT_LAND_URL_PREFIX));
     }
 
+    // already parsed while streaming, or nothing to parse
+    if (streaming || notModified)
+    {
+      loopCnt++;
+      continue;
+    }
+
     // find key
     if (responseDoc[arrKeyName].isNull())
     {
@@ -94,10 +230,10 @@ bool BaseRetriever::loopRequest(
       parseOneElement(elementDoc);
     }
 
-    delay(PING_DELAY); // so we don't overwhelm server
     loopCnt++;
   }
 
+  pages = loopCnt;
   return true;
 }
 
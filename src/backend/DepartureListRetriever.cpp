@@ -1,56 +1,501 @@
 #include "backend/DepartureListRetriever.h"
 
+#include <algorithm>
+#include <climits>
+
 #include "backend/APICaller.h"
 #include "backend/TimeRetriever.h"
 #include "backend/DepartureRetriever.h"
 
+namespace
+{
+  // bounds on how often one stop is fetched
+  const unsigned long MIN_STOP_INTERVAL = 20000;  // ms
+  const unsigned long MAX_STOP_INTERVAL = 600000; // ms
+
+  // a real-time departure this close keeps its stop at the minimum interval
+  const std::time_t HOT_DEPARTURE_WINDOW = 300; // s
+
+  // otherwise a stop is refetched after this fraction of the time to its next departure
+  const unsigned long PROXIMITY_DIVISOR = 4;
+
+  // schedule-only stops, and stops whose last fetch changed nothing, wait this many times longer
+  const unsigned long STATIC_FACTOR = 2;
+  const unsigned long UNCHANGED_FACTOR = 2;
+
+  // cached stops go stale at different times, so keep spare departures to fill in for ones that leave
+  const int PUBLISHED_LIST_FACTOR = 2;
+}
+
 DepartureListRetriever::DepartureListRetriever(APICaller *caller,
                                                TimeRetriever *time,
                                                const DepartureRetrieverConfig &config)
-    : m_time{time}, m_caller{caller}, m_departureList{config.departureLimit}, m_config{config} {}
+    : m_time{time}, m_caller{caller}, m_async{nullptr},
+      m_published{std::make_shared<const DepartureList>(config.departureLimit)}, m_config{config},
+      m_statsStartMs{0}, m_requests{0} {}
 
-void DepartureListRetriever::init(RouteList routeList, StopList stopList)
+/**
+ * Borrows the zone's route list; stops are flattened once here rather than on every refresh
+ *
+ * Stops that were already known keep their departures and interval.
+ */
+void DepartureListRetriever::init(const RouteListPtr &routeList, const StopListPtr &stopList)
 {
-  m_routeList = routeList;
-  m_stops = stopList.getAllStops();
+  // in-flight batches index into the old stops
+  waitForInFlight();
+
+  std::atomic_store(&m_routeList, routeList);
+  std::vector<Stop> stops = stopList->getAllStops();
+
+  std::lock_guard<std::mutex> lock(m_statesMtx);
+  std::vector<StopState> states;
+  states.reserve(stops.size());
+  for (const Stop &stop : stops)
+  {
+    StopState state{DepartureList(m_config.departureLimit), 0, MIN_STOP_INTERVAL, false};
+    for (int i = 0; i < m_stops.size(); i++)
+    {
+      if (m_stops[i].onestopId == stop.onestopId)
+      {
+        state = m_stopStates[i];
+        break;
+      }
+    }
+    states.push_back(state);
+  }
+
+  m_stops = std::move(stops);
+  m_stopStates = std::move(states);
+  if (m_statsStartMs == 0)
+  {
+    m_statsStartMs = millis();
+  }
 }
 
 /**
+ * With an async caller, due batches are fetched on its workers, one per
+ * connection, instead of one after another on the calling task
+ */
+void DepartureListRetriever::setAsyncCaller(AsyncAPICaller *async)
+{
+  m_async = async;
+}
+
+/**
+ * Called after every publish, on whichever task published; with
+ * retrieveAsync() that is an async worker. Set only while nothing is in flight.
+ */
+void DepartureListRetriever::setOnPublished(const PublishCallback &onPublished)
+{
+  m_onPublished = onPublished;
+}
+
+/**
+ * Fetches the stops that are due, or all of them if allStops is set, and
+ * publishes a list merged from every stop's latest departures. Due stops
+ * are grouped stopsPerRequest at a time into one request each.
+ *
  * Returns false if AT LEAST ONE departure went wrong
+ *
+ * A cancelled retrieve returns once every in-flight request has unwound,
+ * and keeps the previously published list.
+ */
+bool DepartureListRetriever::retrieve(const CancellationToken &cancel, const bool allStops)
+{
+  std::vector<std::vector<int>> batches = collectDueBatches(allStops);
+
+  int numWorkers = m_async == nullptr ? 1 : std::min(m_config.parallelism, m_async->getWorkerCount());
+  bool res;
+  if (numWorkers <= 1 || batches.size() <= 1)
+  {
+    res = retrieveSequential(batches, cancel);
+  }
+  else
+  {
+    res = retrieveParallel(batches, cancel);
+  }
+
+  if (cancel.isCancelled())
+  {
+    return false;
+  }
+
+  publish();
+  return res;
+}
+
+/**
+ * Hands the due stops to the async caller's workers and returns without
+ * waiting. Each batch is merged in and published from its completion
+ * callback as soon as it lands; stops in flight are not handed out again.
+ *
+ * Returns false, having sent nothing, if there are no workers to hand them to
+ */
+bool DepartureListRetriever::retrieveAsync(const bool allStops)
+{
+  if (m_async == nullptr || m_async->getWorkerCount() == 0)
+    return false;
+
+  std::vector<std::vector<int>> batches = collectDueBatches(allStops);
+
+  std::lock_guard<std::mutex> lock(m_statesMtx);
+  m_inFlight.erase(std::remove_if(m_inFlight.begin(), m_inFlight.end(),
+                                  [](const AsyncRequestPtr &request)
+                                  { return request->isDone(); }),
+                   m_inFlight.end());
+  for (const std::vector<int> &batch : batches)
+  {
+    for (int idx : batch)
+    {
+      m_stopStates[idx].inFlight = true;
+    }
+    // the batch is copied, since the job outlives this call
+    m_inFlight.push_back(m_async->submit(
+        [this, batch](APICaller *caller)
+        { return fetchStops(caller, batch, m_asyncCancel); },
+        [this](const bool)
+        {
+          if (!m_asyncCancel.isCancelled())
+          {
+            publish();
+          }
+        }));
+  }
+  return true;
+}
+
+/**
+ * Cancels the batches from retrieveAsync() and returns once every one has
+ * unwound; they keep their stops' last departures
+ */
+void DepartureListRetriever::cancelInFlight()
+{
+  m_asyncCancel.cancel();
+  waitForInFlight();
+  m_asyncCancel.reset();
+}
+
+void DepartureListRetriever::clear()
+{
+  cancelInFlight();
+  {
+    std::lock_guard<std::mutex> lock(m_statesMtx);
+    for (StopState &state : m_stopStates)
+    {
+      state = StopState{DepartureList(m_config.departureLimit), 0, MIN_STOP_INTERVAL, false};
+    }
+  }
+  std::atomic_store(&m_published, DepartureListPtr(std::make_shared<const DepartureList>(m_config.departureLimit)));
+}
+
+/**
+ * Last complete list; safe to call from any task while retrieve() runs
+ */
+DepartureListPtr DepartureListRetriever::getDepartureList() const
+{
+  return std::atomic_load(&m_published);
+}
+
+/**
+ * About how many API requests a retrieve() now would send
+ */
+int DepartureListRetriever::getDueRequestCount(const bool allStops) const
+{
+  std::lock_guard<std::mutex> lock(m_statesMtx);
+  unsigned long now = millis();
+  int count = 0;
+  for (const StopState &state : m_stopStates)
+  {
+    if (!state.inFlight && (allStops || isDue(state, now)))
+      count++;
+  }
+  int perRequest = std::max(m_config.stopsPerRequest, 1);
+  return (count + perRequest - 1) / perRequest;
+}
+
+/**
+ * Time until the first stop is due; 0 if one already is. Stops in flight
+ * are left out until they land.
+ */
+unsigned long DepartureListRetriever::msUntilNextDue() const
+{
+  std::lock_guard<std::mutex> lock(m_statesMtx);
+  unsigned long now = millis();
+  unsigned long res = MAX_STOP_INTERVAL;
+  for (const StopState &state : m_stopStates)
+  {
+    if (state.inFlight)
+      continue;
+    if (isDue(state, now))
+      return 0;
+    res = std::min(res, state.intervalMs - (now - state.fetchedMs));
+  }
+  return res;
+}
+
+/**
+ * Whether any stop is in a batch from retrieveAsync() that has not landed yet
+ */
+bool DepartureListRetriever::hasInFlight() const
+{
+  std::lock_guard<std::mutex> lock(m_statesMtx);
+  return std::any_of(m_stopStates.begin(), m_stopStates.end(),
+                     [](const StopState &state)
+                     { return state.inFlight; });
+}
+
+void DepartureListRetriever::debugPrintStats() const
+{
+  std::lock_guard<std::mutex> lock(m_statesMtx);
+  unsigned long now = millis();
+  unsigned long maxAge = 0, totalAge = 0, totalInterval = 0;
+  int fetched = 0;
+  for (const StopState &state : m_stopStates)
+  {
+    if (state.fetchedMs == 0)
+      continue;
+    unsigned long age = now - state.fetchedMs;
+    maxAge = std::max(maxAge, age);
+    totalAge += age;
+    totalInterval += state.intervalMs;
+    fetched++;
+  }
+
+  unsigned long elapsedMs = m_statsStartMs == 0 ? 0 : now - m_statsStartMs;
+  Serial.print(F("Stops fetched: "));
+  Serial.print(fetched);
+  Serial.print(F("/"));
+  Serial.println(m_stopStates.size());
+  Serial.print(F("API calls/hour: "));
+  Serial.println(elapsedMs == 0 ? 0.0f : m_requests * 3600000.0f / elapsedMs);
+  Serial.print(F("Stops per request: "));
+  Serial.println(std::max(m_config.stopsPerRequest, 1));
+  Serial.print(F("Staleness now (s) avg: "));
+  Serial.print(fetched == 0 ? 0 : totalAge / fetched / 1000);
+  Serial.print(F(" max: "));
+  Serial.println(maxAge / 1000);
+  Serial.print(F("Avg stop interval (s): "));
+  Serial.println(fetched == 0 ? 0 : totalInterval / fetched / 1000);
+}
+
+/**
+ * Groups the due stops that are not in flight, stopsPerRequest at a time
  */
-bool DepartureListRetriever::retrieve()
+std::vector<std::vector<int>> DepartureListRetriever::collectDueBatches(const bool allStops)
 {
-  clear();
+  std::vector<std::vector<int>> batches;
+  std::lock_guard<std::mutex> lock(m_statesMtx);
+  unsigned long now = millis();
+  int perRequest = std::max(m_config.stopsPerRequest, 1);
+  for (int i = 0; i < m_stopStates.size(); i++)
+  {
+    if (m_stopStates[i].inFlight || (!allStops && !isDue(m_stopStates[i], now)))
+      continue;
+    if (batches.empty() || batches.back().size() >= perRequest)
+    {
+      batches.emplace_back();
+    }
+    batches.back().push_back(i);
+  }
+  return batches;
+}
 
+bool DepartureListRetriever::retrieveSequential(const std::vector<std::vector<int>> &batches,
+                                                const CancellationToken &cancel)
+{
   bool res = true;
-  for (const Stop &stop : m_stops)
+  for (const std::vector<int> &batch : batches)
   {
-    DepartureRetriever depRetriever(m_caller,
-                                    m_time,
-                                    stop,
-                                    m_routeList,
-                                    m_config);
+    if (cancel.isCancelled())
+      return false;
 
-    if (depRetriever.retrieve())
+    // don't fail - we still may want other departures as well
+    res = fetchStops(m_caller, batch, cancel) && res;
+  }
+  return res;
+}
+
+/**
+ * Submits every due batch to the async caller and blocks until all have
+ * completed, for callers that need the departures before going on
+ */
+bool DepartureListRetriever::retrieveParallel(const std::vector<std::vector<int>> &batches,
+                                              const CancellationToken &cancel)
+{
+  std::vector<AsyncRequestPtr> requests;
+  requests.reserve(batches.size());
+  for (const std::vector<int> &batch : batches)
+  {
+    // batch and cancel outlive the job, since this waits for every job below
+    requests.push_back(m_async->submit(
+        [this, &batch, &cancel](APICaller *caller)
+        { return fetchStops(caller, batch, cancel); }));
+  }
+
+  bool res = true;
+  for (const AsyncRequestPtr &request : requests)
+  {
+    res = request->wait() && res;
+  }
+  return res;
+}
+
+void DepartureListRetriever::waitForInFlight()
+{
+  std::vector<AsyncRequestPtr> requests;
+  {
+    std::lock_guard<std::mutex> lock(m_statesMtx);
+    requests.swap(m_inFlight);
+  }
+  for (const AsyncRequestPtr &request : requests)
+  {
+    request->wait();
+  }
+}
+
+/**
+ * Fetches a batch of stops in one request and schedules each stop's next
+ * fetch. Failed stops keep their last departures and are retried after the
+ * minimum interval; so are stops a successful batch left out.
+ */
+bool DepartureListRetriever::fetchStops(APICaller *caller, const std::vector<int> &stopIdxs,
+                                        const CancellationToken &cancel)
+{
+  if (cancel.isCancelled())
+  {
+    std::lock_guard<std::mutex> lock(m_statesMtx);
+    for (int idx : stopIdxs)
     {
-      m_departureList.concat(depRetriever.getDepartureList());
+      m_stopStates[idx].inFlight = false;
+    }
+    return false;
+  }
+
+  std::vector<Stop> stops;
+  stops.reserve(stopIdxs.size());
+  for (int idx : stopIdxs)
+  {
+    stops.push_back(m_stops[idx]);
+  }
+
+  DepartureRetriever depRetriever(caller,
+                                  m_time,
+                                  stops,
+                                  std::atomic_load(&m_routeList),
+                                  m_config);
+  depRetriever.setCancellationToken(cancel);
+  bool res = depRetriever.retrieve();
+  m_requests += depRetriever.getRequestCount();
+
+  std::lock_guard<std::mutex> lock(m_statesMtx);
+  if (cancel.isCancelled())
+  {
+    for (int idx : stopIdxs)
+    {
+      m_stopStates[idx].inFlight = false;
+    }
+    return false;
+  }
+
+  unsigned long now = millis();
+  bool allOk = res;
+  for (int i = 0; i < stopIdxs.size(); i++)
+  {
+    StopState &state = m_stopStates[stopIdxs[i]];
+    state.inFlight = false;
+    // a lone stop's response is always its own, even with nothing in it
+    bool ok = res && (stopIdxs.size() == 1 || depRetriever.wasReturned(i));
+    if (res && !ok)
+    {
+      Serial.println(("Stop missing from batched response: " + StringInterner::str(stops[i].onestopId)).c_str());
+      allOk = false;
+    }
+
+    if (ok)
+    {
+      DepartureList fetched = depRetriever.getDepartureList(i);
+      state.intervalMs = nextInterval(state, fetched);
+      state.departures = std::move(fetched);
     }
     else
     {
-      // don't fail - we still may want other departures as well
-      res = false;
+      state.intervalMs = MIN_STOP_INTERVAL;
     }
+    state.fetchedMs = now;
   }
+  return allOk;
+}
 
-  return res;
+bool DepartureListRetriever::isDue(const StopState &state, const unsigned long now) const
+{
+  return state.fetchedMs == 0 || now - state.fetchedMs >= state.intervalMs;
 }
 
-void DepartureListRetriever::clear()
+/**
+ * How long until a stop with these freshly fetched departures is fetched again
+ */
+unsigned long DepartureListRetriever::nextInterval(const StopState &state, const DepartureList &fetched) const
 {
-  m_departureList.clear();
+  const std::vector<Departure> &departures = fetched.getDepartures();
+  if (departures.empty())
+    return MAX_STOP_INTERVAL;
+
+  std::time_t curTime = m_time->getCurTime();
+  std::time_t secsToNext = std::max<std::time_t>(departures.front().actualTimestamp - curTime, 0);
+  bool anyRealTime = std::any_of(departures.begin(), departures.end(),
+                                 [](const Departure &dep)
+                                 { return dep.isRealTime; });
+
+  if (anyRealTime && secsToNext <= HOT_DEPARTURE_WINDOW)
+    return MIN_STOP_INTERVAL;
+
+  unsigned long interval = static_cast<unsigned long>(secsToNext) * 1000UL / PROXIMITY_DIVISOR;
+  if (!anyRealTime)
+  {
+    interval *= STATIC_FACTOR;
+  }
+
+  // back off while fetches keep returning the same departures
+  if (state.fetchedMs != 0 && fetched.hasSameDepartures(state.departures))
+  {
+    interval = std::max(interval, state.intervalMs * UNCHANGED_FACTOR);
+  }
+
+  // refetch before every cached departure has left
+  std::time_t secsToLast = departures.back().actualTimestamp - curTime;
+  if (secsToLast > 0)
+  {
+    interval = std::min(interval, static_cast<unsigned long>(secsToLast) * 1000UL);
+  }
+
+  return std::min(std::max(interval, MIN_STOP_INTERVAL), MAX_STOP_INTERVAL);
 }
 
-DepartureList DepartureListRetriever::getDepartureList() const
+/**
+ * Merges every stop's latest departures, minus ones that have left since
+ * their stop was fetched, and hands the result to readers
+ */
+void DepartureListRetriever::publish()
 {
-  return m_departureList;
-}
\ No newline at end of file
+  std::lock_guard<std::mutex> publishLock(m_publishMtx);
+  std::time_t cutoff = m_time->getCurTime() - m_config.timestampCutoff;
+  std::vector<DepartureList> stopLists;
+  {
+    std::lock_guard<std::mutex> lock(m_statesMtx);
+    stopLists.reserve(m_stopStates.size());
+    for (const StopState &state : m_stopStates)
+    {
+      stopLists.push_back(state.departures);
+      stopLists.back().removeAllBefore(cutoff);
+    }
+  }
+
+  // readers keep whichever list they already hold; the new one is never modified
+  DepartureList merged = DepartureList::merge(stopLists, m_config.departureLimit * PUBLISHED_LIST_FACTOR);
+  std::atomic_store(&m_published, DepartureListPtr(std::make_shared<const DepartureList>(std::move(merged))));
+
+  if (m_onPublished)
+  {
+    m_onPublished();
+  }
+}
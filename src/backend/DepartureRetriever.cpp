@@ -19,32 +19,66 @@ namespace
 DepartureRetriever::DepartureRetriever(APICaller *caller,
                                        TimeRetriever *time,
                                        const Stop &stop,
-                                       const RouteList &routeList,
+                                       const RouteListPtr &routeList,
+                                       const DepartureRetrieverConfig &config)
+    : DepartureRetriever{caller, time, std::vector<Stop>{stop}, routeList, config}
+{
+}
+
+/**
+ * Fetches every stop in one request, with departures embedded per stop
+ */
+DepartureRetriever::DepartureRetriever(APICaller *caller,
+                                       TimeRetriever *time,
+                                       const std::vector<Stop> &stops,
+                                       const RouteListPtr &routeList,
                                        const DepartureRetrieverConfig &config)
     : BaseRetriever{
           caller,
-          constructEndpointString(stop, config.departureLimit, config.nextNSeconds),
+          constructEndpointString(stops, config.departureLimit, config.nextNSeconds),
           DEPARTURES_MAX_PAGES_PROCESSED, Constants::DEPARTURE_ERROR_PIN},
-      m_time{time}, m_stop{stop}, m_routeList{routeList}, m_departureConfig{config}
+      m_time{time}, m_stops{stops}, m_routeList{routeList},
+      m_departures(stops.size()),
+      m_returned(stops.size(), false),
+      m_curStopIdx{0}, m_departureConfig{config}
 {
 }
 
 bool DepartureRetriever::retrieve()
 {
-  m_departures.clear();
-  JsonDocument filter = constructFilter();
-  bool res = loopRequest(filter, DEPARTURES_STOPS_KEY_NAME, DEPARTURES_NESTING_LIMIT);
+  for (DepartureList &departures : m_departures)
+  {
+    departures.clear();
+  }
+  m_returned.assign(m_stops.size(), false);
+  bool res = loopRequest(getFilter(), DEPARTURES_STOPS_KEY_NAME, DEPARTURES_NESTING_LIMIT);
 
   // remove all before current time
   std::time_t curTime = m_time->getCurTime();
-  m_departures.removeAllBefore(curTime - m_departureConfig.timestampCutoff);
+  for (DepartureList &departures : m_departures)
+  {
+    departures.removeAllBefore(curTime - m_departureConfig.timestampCutoff);
+  }
 
   return res;
 }
 
-DepartureList DepartureRetriever::getDepartureList() const
+/**
+ * Departures of the stopIdx-th stop passed in
+ */
+DepartureList DepartureRetriever::getDepartureList(const int stopIdx) const
 {
-  return m_departures;
+  return m_departures[stopIdx];
+}
+
+/**
+ * Whether the last retrieve() got an element for the stopIdx-th stop. A
+ * batched response can leave stops out, and an empty list would then look
+ * like a stop with no departures.
+ */
+bool DepartureRetriever::wasReturned(const int stopIdx) const
+{
+  return m_returned[stopIdx];
 }
 
 void DepartureRetriever::parseOneElement(JsonVariantConst &stopInfo)
@@ -55,6 +89,14 @@ void DepartureRetriever::parseOneElement(JsonVariantConst &stopInfo)
     return;
   }
 
+  // batched responses hold several stops; match this one to the stop it was asked for
+  m_curStopIdx = findStop(stopInfo);
+  if (m_curStopIdx < 0)
+  {
+    return;
+  }
+  m_returned[m_curStopIdx] = true;
+
   // extract info from stop
   // departures
   if (!stopInfo["departures"].is<JsonArrayConst>() || stopInfo["departures"].size() <= 0)
@@ -79,6 +121,16 @@ void DepartureRetriever::parseOneElement(JsonVariantConst &stopInfo)
   }
 }
 
+/**
+ * Built once and shared read-only by every instance, rather than rebuilt
+ * for each stop on every refresh
+ */
+const JsonDocument &DepartureRetriever::getFilter()
+{
+  static const JsonDocument filter = constructFilter();
+  return filter;
+}
+
 JsonDocument DepartureRetriever::constructFilter()
 {
   JsonDocument filter;
@@ -86,6 +138,7 @@ JsonDocument DepartureRetriever::constructFilter()
 
   JsonObject filter_stops_0 = filter["stops"].add<JsonObject>();
   filter_stops_0["location_type"] = true;
+  filter_stops_0["onestop_id"] = true;
 
   JsonObject filter_stops_0_departures_0 = filter_stops_0["departures"].add<JsonObject>();
   filter_stops_0_departures_0["schedule_relationship"] = true;
@@ -105,21 +158,54 @@ JsonDocument DepartureRetriever::constructFilter()
   return filter;
 }
 
+/**
+ * Several stops are requested at once as a comma-joined list of stop keys
+ *
+ * The comma-joined path has not been verified against the live API, so
+ * batching stays opt-in per zone (batchDepartures) and off by default.
+ */
 std::string DepartureRetriever::constructEndpointString(
-    const Stop &stop, const int departureLimit, const int nextNSeconds)
+    const std::vector<Stop> &stops, const int departureLimit, const int nextNSeconds)
 {
   std::string res = Constants::STOPS_ENDPOINT_PREFIX;
-  res += std::string("/") + stop.onestopId + "/departures";
+  res += "/";
+  for (int i = 0; i < stops.size(); i++)
+  {
+    if (i > 0)
+      res += ",";
+    res += StringInterner::str(stops[i].onestopId);
+  }
+  res += "/departures";
   res += std::string("?limit=") + std::to_string(departureLimit);
   res += std::string("&next=") + std::to_string(nextNSeconds);
   res += "&include_alerts=true&use_service_window=false";
   return res;
 }
 
+/**
+ * Index into m_stops of the stop a response element belongs to, or -1
+ */
+int DepartureRetriever::findStop(JsonVariantConst &stopInfo) const
+{
+  // a single stop's response is always for that stop
+  if (m_stops.size() == 1)
+    return 0;
+
+  const char *onestopId = stopInfo["onestop_id"].as<const char *>();
+  if (onestopId == nullptr)
+    return -1;
+  for (int i = 0; i < m_stops.size(); i++)
+  {
+    if (StringInterner::str(m_stops[i].onestopId) == onestopId)
+      return i;
+  }
+  return -1;
+}
+
 void DepartureRetriever::parseOneDeparture(JsonVariantConst &departureDoc)
 {
   Departure departure;
-  departure.stop = m_stop;
+  departure.stop = m_stops[m_curStopIdx];
   departure.isValid = true;
 
   if (!retrieveIsRealTime(departureDoc, departure))
@@ -131,7 +217,7 @@ void DepartureRetriever::parseOneDeparture(JsonVariantConst &departureDoc)
   if (!retrieveTimestampDelay(departureDoc, departure))
     return;
 
-  m_departures.addDeparture(departure);
+  m_departures[m_curStopIdx].addDeparture(departure);
 }
 
 bool DepartureRetriever::retrieveIsRealTime(JsonVariantConst &departureDoc, Departure &departure)
@@ -167,20 +253,20 @@ bool DepartureRetriever::retrieveIsRealTime(JsonVariantConst &departureDoc, Depa
 
 bool DepartureRetriever::retrieveHeadsign(JsonVariantConst &departureDoc, Departure &departure)
 {
-  std::string headsign;
+  const char *headsign;
   // look for key "stop_headsign" or ["trip"]["trip_headsign"]
   // prioritize ["trip"]["trip_headsign"]
   if (departureDoc["trip"]["trip_headsign"].isNull())
   {
     if (departureDoc["stop_headsign"].isNull())
       return false;
-    headsign = departureDoc["stop_headsign"].as<std::string>();
+    headsign = departureDoc["stop_headsign"].as<const char *>();
   }
   else
   {
-    headsign = departureDoc["trip"]["trip_headsign"].as<std::string>();
+    headsign = departureDoc["trip"]["trip_headsign"].as<const char *>();
   }
-  departure.direction = headsign;
+  departure.direction = headsign == nullptr ? "" : headsign;
 
   return true;
 }
@@ -193,13 +279,15 @@ bool DepartureRetriever::retrieveRoute(JsonVariantConst &departureDoc, Departure
     return false;
 
   // get route of onestop ID, and get route object from onestop ID
-  std::string onestopId = departureDoc["trip"]["route"]["onestop_id"].as<std::string>();
-  if (!m_routeList.routeExists(onestopId))
+  // every known route was interned when the route list was built
+  InternId onestopId = StringInterner::find(departureDoc["trip"]["route"]["onestop_id"].as<const char *>());
+  const Route *route = onestopId == StringInterner::EMPTY ? nullptr : m_routeList->findRoute(onestopId);
+  if (route == nullptr)
     return false;
-  departure.route = m_routeList.getRoute(onestopId);
+  departure.route = *route;
   if (departureDoc["trip"]["route"]["agency"].isNull() || departureDoc["trip"]["route"]["agency"]["onestop_id"].isNull())
     return false;
-  departure.agencyOnestopId = departureDoc["trip"]["route"]["agency"]["onestop_id"].as<std::string>();
+  departure.agencyOnestopId = StringInterner::intern(departureDoc["trip"]["route"]["agency"]["onestop_id"].as<const char *>());
 
   return true;
 }
@@ -210,13 +298,14 @@ bool DepartureRetriever::retrieveTimestampDelay(JsonVariantConst &departureDoc,
     return false;
   JsonVariantConst depInfo = departureDoc["departure"];
 
-  std::string timestampActualStr;
-  std::string timestampExpectedStr;
+  // pointers into the JSON document; nullptr if missing
+  const char *timestampActualStr = nullptr;
+  const char *timestampExpectedStr = nullptr;
   bool delayKeyFound = false;
 
-  // set to scheduled UTC, if null it will be empty string
+  // set to scheduled UTC, if null it will stay nullptr
   if (!depInfo["scheduled_utc"].isNull())
-    timestampExpectedStr = depInfo["scheduled_utc"].as<std::string>(); // aka scheduled
+    timestampExpectedStr = depInfo["scheduled_utc"].as<const char *>(); // aka scheduled
 
   // default value - will be set later
   departure.delay = 0;
@@ -235,7 +324,7 @@ bool DepartureRetriever::retrieveTimestampDelay(JsonVariantConst &departureDoc,
   {
     // treat as if real time
     // estimated_utc is guaranteed not to be null
-    timestampActualStr = depInfo["estimated_utc"].as<std::string>();
+    timestampActualStr = depInfo["estimated_utc"].as<const char *>();
 
     // set delay if found in response
     if (!depInfo["estimated_delay"].isNull())
@@ -251,7 +340,7 @@ bool DepartureRetriever::retrieveTimestampDelay(JsonVariantConst &departureDoc,
 
   // manually calculate delay if not found in response
   // this means that timestamp expected string
-  if (!delayKeyFound && timestampExpectedStr != "" && departure.isRealTime)
+  if (!delayKeyFound && timestampExpectedStr != nullptr && departure.isRealTime)
   {
     departure.delay = static_cast<long long>(departure.actualTimestamp) - static_cast<long long>(departure.expectedTimestamp);
   }
@@ -265,9 +354,7 @@ bool DepartureRetriever::retrieveTimestampDelay(JsonVariantConst &departureDoc,
   return true;
 }
 
-std::time_t DepartureRetriever::convertTime(const std::string &str)
+std::time_t DepartureRetriever::convertTime(const char *str)
 {
-  struct tm timeinfo;
-  strptime(str.c_str(), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
-  return m_time->timegmUTC(&timeinfo);
+  return TimeRetriever::parseISO8601UTC(str);
 }
\ No newline at end of file
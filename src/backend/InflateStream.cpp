@@ -0,0 +1,295 @@
+#include "backend/InflateStream.h"
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+
+namespace
+{
+  const size_t WINDOW_SIZE = TINFL_LZ_DICT_SIZE; // must stay a power of two
+  const size_t INPUT_BUFFER_SIZE = 1024;
+
+  const uint8_t GZIP_MAGIC_1 = 0x1f;
+  const uint8_t GZIP_MAGIC_2 = 0x8b;
+  const uint8_t GZIP_METHOD_DEFLATE = 8;
+  const size_t GZIP_HEADER_SIZE = 10;
+  const size_t GZIP_TRAILER_SIZE = 8; // CRC32 and size; read but not checked
+
+  const uint8_t GZIP_FLAG_HCRC = 0x02;
+  const uint8_t GZIP_FLAG_EXTRA = 0x04;
+  const uint8_t GZIP_FLAG_NAME = 0x08;
+  const uint8_t GZIP_FLAG_COMMENT = 0x10;
+
+  void *allocPreferPsram(const size_t size)
+  {
+    void *res = nullptr;
+    if (psramFound())
+    {
+      res = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    if (res == nullptr)
+    {
+      res = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    }
+    return res;
+  }
+}
+
+InflateStream::InflateStream()
+    : m_upstream{nullptr}, m_decomp{nullptr}, m_window{nullptr}, m_input{nullptr},
+      m_inputPos{0}, m_inputLen{0}, m_outPos{0}, m_readPos{0}, m_pending{0},
+      m_compressed{0}, m_inflated{0}, m_finished{true}, m_failed{false} {}
+
+InflateStream::~InflateStream()
+{
+  release();
+}
+
+/**
+ * Starts inflating a new body; returns false if the buffers could not be
+ * allocated or the gzip header is invalid
+ */
+bool InflateStream::begin(Stream &upstream)
+{
+  if (!allocate())
+    return false;
+
+  m_upstream = &upstream;
+  tinfl_init(m_decomp);
+  m_inputPos = m_inputLen = 0;
+  m_outPos = m_readPos = m_pending = 0;
+  m_compressed = m_inflated = 0;
+  m_finished = false;
+  m_failed = false;
+
+  if (!readHeader())
+  {
+    m_failed = true;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Inflates and discards the rest of the body, through the trailer
+ *
+ * Returns false if it did not end cleanly, so the connection can't be reused
+ */
+bool InflateStream::finish()
+{
+  while (fill())
+  {
+    m_pending = 0;
+  }
+  return m_finished && !m_failed;
+}
+
+/**
+ * Detaches from the upstream; the buffers are kept for the next body
+ */
+void InflateStream::end()
+{
+  m_upstream = nullptr;
+  m_pending = 0;
+  m_finished = true;
+}
+
+int InflateStream::available()
+{
+  if (m_pending == 0 && m_upstream != nullptr && m_upstream->available() > 0)
+  {
+    fill();
+  }
+  return m_pending;
+}
+
+int InflateStream::peek()
+{
+  if (!fill())
+    return -1;
+  return m_window[m_readPos];
+}
+
+int InflateStream::read()
+{
+  if (!fill())
+    return -1;
+  int c = m_window[m_readPos];
+  m_readPos = (m_readPos + 1) & (WINDOW_SIZE - 1);
+  m_pending--;
+  return c;
+}
+
+size_t InflateStream::readBytes(char *buffer, size_t length)
+{
+  size_t n = 0;
+  while (n < length && fill())
+  {
+    // inflated bytes never wrap within one fill, so one copy per fill
+    size_t chunk = std::min(length - n, m_pending);
+    memcpy(buffer + n, m_window + m_readPos, chunk);
+    m_readPos = (m_readPos + chunk) & (WINDOW_SIZE - 1);
+    m_pending -= chunk;
+    n += chunk;
+  }
+  return n;
+}
+
+/**
+ * Body bytes read from upstream, including the gzip header and trailer
+ */
+size_t InflateStream::compressedCount() const { return m_compressed; }
+size_t InflateStream::inflatedCount() const { return m_inflated; }
+bool InflateStream::failed() const { return m_failed; }
+
+bool InflateStream::allocate()
+{
+  if (m_window != nullptr)
+    return true;
+
+  m_decomp = static_cast<tinfl_decompressor *>(allocPreferPsram(sizeof(tinfl_decompressor)));
+  m_window = static_cast<uint8_t *>(allocPreferPsram(WINDOW_SIZE));
+  m_input = static_cast<uint8_t *>(heap_caps_malloc(INPUT_BUFFER_SIZE, MALLOC_CAP_8BIT));
+  if (m_decomp == nullptr || m_window == nullptr || m_input == nullptr)
+  {
+    Serial.println(F("Inflate: could not allocate buffers"));
+    release();
+    return false;
+  }
+  return true;
+}
+
+void InflateStream::release()
+{
+  heap_caps_free(m_decomp);
+  heap_caps_free(m_window);
+  heap_caps_free(m_input);
+  m_decomp = nullptr;
+  m_window = nullptr;
+  m_input = nullptr;
+}
+
+/**
+ * Reads the gzip member header, skipping the optional fields
+ */
+bool InflateStream::readHeader()
+{
+  uint8_t header[GZIP_HEADER_SIZE];
+  size_t n = m_upstream->readBytes(reinterpret_cast<char *>(header), GZIP_HEADER_SIZE);
+  m_compressed += n;
+  if (n != GZIP_HEADER_SIZE ||
+      header[0] != GZIP_MAGIC_1 || header[1] != GZIP_MAGIC_2 || header[2] != GZIP_METHOD_DEFLATE)
+    return false;
+
+  uint8_t flags = header[3];
+  if (flags & GZIP_FLAG_EXTRA)
+  {
+    uint8_t len[2];
+    if (m_upstream->readBytes(reinterpret_cast<char *>(len), 2) != 2)
+      return false;
+    m_compressed += 2;
+    if (!skipUpstream(len[0] | (len[1] << 8)))
+      return false;
+  }
+  if ((flags & GZIP_FLAG_NAME) && !skipUpstreamString())
+    return false;
+  if ((flags & GZIP_FLAG_COMMENT) && !skipUpstreamString())
+    return false;
+  if ((flags & GZIP_FLAG_HCRC) && !skipUpstream(2))
+    return false;
+  return true;
+}
+
+bool InflateStream::skipUpstream(size_t length)
+{
+  char c;
+  while (length > 0)
+  {
+    if (m_upstream->readBytes(&c, 1) != 1)
+      return false;
+    m_compressed++;
+    length--;
+  }
+  return true;
+}
+
+bool InflateStream::skipUpstreamString()
+{
+  char c;
+  do
+  {
+    if (m_upstream->readBytes(&c, 1) != 1)
+      return false;
+    m_compressed++;
+  } while (c != '\0');
+  return true;
+}
+
+/**
+ * Reads whatever compressed bytes have arrived, or waits for one
+ *
+ * Never asks for more than is available, so it can't block past the end of the body.
+ */
+bool InflateStream::refillInput()
+{
+  int avail = m_upstream->available();
+  size_t want = avail > 0 ? std::min(static_cast<size_t>(avail), INPUT_BUFFER_SIZE) : 1;
+  m_inputLen = m_upstream->readBytes(reinterpret_cast<char *>(m_input), want);
+  m_inputPos = 0;
+  m_compressed += m_inputLen;
+  return m_inputLen > 0;
+}
+
+/**
+ * Inflates more once every inflated byte has been handed out
+ *
+ * Returns whether any inflated bytes are pending
+ */
+bool InflateStream::fill()
+{
+  while (m_pending == 0 && !m_finished && !m_failed && m_upstream != nullptr)
+  {
+    if (m_inputPos == m_inputLen && !refillInput())
+    {
+      // timed out or the body ended early
+      m_failed = true;
+      break;
+    }
+
+    size_t inSize = m_inputLen - m_inputPos;
+    size_t outSize = WINDOW_SIZE - m_outPos;
+    tinfl_status status = tinfl_decompress(m_decomp,
+                                           m_input + m_inputPos, &inSize,
+                                           m_window, m_window + m_outPos, &outSize,
+                                           TINFL_FLAG_HAS_MORE_INPUT);
+    m_inputPos += inSize;
+    m_readPos = m_outPos;
+    m_pending = outSize;
+    m_inflated += outSize;
+    m_outPos = (m_outPos + outSize) & (WINDOW_SIZE - 1);
+
+    if (status == TINFL_STATUS_DONE)
+    {
+      m_finished = true;
+      consumeTrailer();
+    }
+    else if (status < TINFL_STATUS_DONE)
+    {
+      m_failed = true;
+    }
+  }
+  return m_pending > 0;
+}
+
+/**
+ * Reads the rest of the trailer so a kept-alive connection starts clean
+ */
+void InflateStream::consumeTrailer()
+{
+  size_t buffered = m_inputLen - m_inputPos;
+  if (buffered < GZIP_TRAILER_SIZE)
+  {
+    skipUpstream(GZIP_TRAILER_SIZE - buffered);
+  }
+  m_inputPos = m_inputLen;
+}
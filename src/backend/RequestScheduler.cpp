@@ -0,0 +1,198 @@
+#include "backend/RequestScheduler.h"
+
+#include <Arduino.h>
+#include <algorithm>
+#include <mutex>
+
+#include "Constants.h"
+
+namespace
+{
+  const int DEFAULT_BURST = 10; // requests
+
+  // waits are sliced so a cancelled request gives up promptly
+  const unsigned long MAX_WAIT_SLICE = 1000; // ms
+
+  const unsigned long BACKOFF_BASE = 1000; // ms
+  const unsigned long BACKOFF_MAX = 60000; // ms
+
+  struct Bucket
+  {
+    std::mutex mtx;
+    float tokens = DEFAULT_BURST;
+    float capacity = DEFAULT_BURST;
+    float refillPerMs = Constants::API_REQUESTS_PER_MINUTE / 60000.0f;
+    unsigned long lastRefillMs = 0;
+    unsigned long pausedUntilMs = 0;
+    bool paused = false;
+    RequestSchedulerStats stats{};
+
+    void refill(const unsigned long now)
+    {
+      if (lastRefillMs != 0)
+      {
+        tokens = std::min(capacity, tokens + (now - lastRefillMs) * refillPerMs);
+      }
+      lastRefillMs = now;
+    }
+  };
+
+  // constructed on first use so other statics can send requests during init
+  Bucket &bucket()
+  {
+    static Bucket b;
+    return b;
+  }
+}
+
+/**
+ * Sets the quota; the bucket starts full
+ */
+void RequestScheduler::configure(const int requestsPerMinute, const int burst)
+{
+  Bucket &b = bucket();
+  std::lock_guard<std::mutex> lock(b.mtx);
+  b.capacity = std::max(burst, 1);
+  b.tokens = b.capacity;
+  b.refillPerMs = requestsPerMinute / 60000.0f;
+  b.lastRefillMs = millis();
+}
+
+/**
+ * Blocks until a request may be sent and takes it from the budget
+ *
+ * Returns false if cancelled while waiting
+ */
+bool RequestScheduler::acquire(const CancellationToken &cancel)
+{
+  Bucket &b = bucket();
+  while (true)
+  {
+    unsigned long waitMs;
+    {
+      std::lock_guard<std::mutex> lock(b.mtx);
+      unsigned long now = millis();
+      b.refill(now);
+
+      if (b.paused && static_cast<long>(b.pausedUntilMs - now) > 0)
+      {
+        waitMs = b.pausedUntilMs - now;
+      }
+      else if (b.tokens >= 1.0f)
+      {
+        b.paused = false;
+        b.tokens -= 1.0f;
+        b.stats.granted++;
+        return true;
+      }
+      else
+      {
+        waitMs = static_cast<unsigned long>((1.0f - b.tokens) / b.refillPerMs) + 1;
+      }
+      waitMs = std::min(waitMs, MAX_WAIT_SLICE);
+      b.stats.waitedMs += waitMs;
+    }
+
+    if (!cancel.sleepFor(waitMs))
+      return false;
+  }
+}
+
+/**
+ * How long until requests could be acquired back to back; 0 if they could now.
+ * More than the burst is capped to a full bucket. Takes nothing from the budget.
+ */
+unsigned long RequestScheduler::msUntilAvailable(const int requests)
+{
+  Bucket &b = bucket();
+  std::lock_guard<std::mutex> lock(b.mtx);
+  unsigned long now = millis();
+  b.refill(now);
+
+  unsigned long pausedMs = 0;
+  float tokens = b.tokens;
+  if (b.paused && static_cast<long>(b.pausedUntilMs - now) > 0)
+  {
+    pausedMs = b.pausedUntilMs - now;
+    tokens = 0; // the pause empties the bucket
+  }
+
+  float wanted = std::min(static_cast<float>(std::max(requests, 1)), b.capacity);
+  if (tokens >= wanted)
+    return pausedMs;
+  return pausedMs + static_cast<unsigned long>((wanted - tokens) / b.refillPerMs) + 1;
+}
+
+/**
+ * Holds back every request for ms, e.g. for a 429's Retry-After. A longer
+ * pause already in place is kept.
+ */
+void RequestScheduler::pauseFor(const unsigned long ms)
+{
+  Bucket &b = bucket();
+  std::lock_guard<std::mutex> lock(b.mtx);
+  unsigned long now = millis();
+  unsigned long remaining = 0;
+  if (b.paused && static_cast<long>(b.pausedUntilMs - now) > 0)
+  {
+    remaining = b.pausedUntilMs - now;
+  }
+  if (ms > remaining)
+  {
+    b.stats.pausedMs += ms - remaining;
+    b.pausedUntilMs = now + ms;
+    b.paused = true;
+  }
+  // whatever was saved up is what got us limited
+  b.tokens = 0;
+}
+
+void RequestScheduler::recordRateLimited()
+{
+  Bucket &b = bucket();
+  std::lock_guard<std::mutex> lock(b.mtx);
+  b.stats.rateLimited++;
+}
+
+void RequestScheduler::recordRetry()
+{
+  Bucket &b = bucket();
+  std::lock_guard<std::mutex> lock(b.mtx);
+  b.stats.retries++;
+}
+
+/**
+ * Delay before retry number attempt (from 0): exponential, capped, with jitter
+ * so that tasks failing together don't retry together
+ */
+unsigned long RequestScheduler::backoffMs(const int attempt)
+{
+  unsigned long delayMs = BACKOFF_BASE << std::min(attempt, 16);
+  delayMs = std::min(delayMs, BACKOFF_MAX);
+  return delayMs / 2 + random(delayMs / 2 + 1);
+}
+
+RequestSchedulerStats RequestScheduler::getStats()
+{
+  Bucket &b = bucket();
+  std::lock_guard<std::mutex> lock(b.mtx);
+  return b.stats;
+}
+
+void RequestScheduler::debugPrintStats()
+{
+  RequestSchedulerStats stats = getStats();
+  Serial.println(F("--- Request Scheduler ---"));
+  Serial.print(F("Requests: "));
+  Serial.println(stats.granted);
+  Serial.print(F("Requests/min since boot: "));
+  Serial.println(millis() == 0 ? 0.0f : stats.granted * 60000.0f / millis());
+  Serial.print(F("Time waiting for budget (ms): "));
+  Serial.println(stats.waitedMs);
+  Serial.print(F("Rate limited (429): "));
+  Serial.println(stats.rateLimited);
+  Serial.print(F("Paused after 429 (ms): "));
+  Serial.println(stats.pausedMs);
+  Serial.print(F("Retries: "));
+  Serial.println(stats.retries);
+}
@@ -42,8 +42,7 @@ RouteRetriever::RouteRetriever(
 bool RouteRetriever::retrieve()
 {
   m_routeList.clear();
-  JsonDocument filter = constructFilter();
-  return loopRequest(filter, ROUTE_KEY_NAME);
+  return loopRequest(getFilter(), ROUTE_KEY_NAME);
 }
 
 RouteList RouteRetriever::getRouteList() const
@@ -69,14 +68,22 @@ void RouteRetriever::parseOneElement(JsonVariantConst &routeDoc)
   }
 
   Route route;
-  route.agencyOnestopId = routeDoc["agency"]["onestop_id"].as<std::string>(); // "o-9q5c-bigbluebus", ...
+  const char *agencyOnestopId = routeDoc["agency"]["onestop_id"].as<const char *>(); // "o-9q5c-bigbluebus", ...
 
-  // check if route is in whitelist
-  if (m_whitelist.isActive() && !m_whitelist.inWhitelist(route.agencyOnestopId))
-    return;
+  // check if route is in whitelist; whitelisted agencies are already interned
+  if (m_whitelist.isActive())
+  {
+    route.agencyOnestopId = StringInterner::find(agencyOnestopId);
+    if (!m_whitelist.inWhitelist(route.agencyOnestopId))
+      return;
+  }
+  else
+  {
+    route.agencyOnestopId = StringInterner::intern(agencyOnestopId);
+  }
 
   // get route name and onestop ID
-  route.onestopId = routeDoc["onestop_id"].as<std::string>(); // "r-9q5c8-1", "r-9q5c8-2", "r-9q5c8-8", ...
+  route.onestopId = StringInterner::intern(routeDoc["onestop_id"].as<const char *>()); // "r-9q5c8-1", "r-9q5c8-2", "r-9q5c8-8", ...
   if (!routeDoc["route_short_name"].is<const char *>())
   {
     route.name = routeDoc["route_long_name"].as<std::string>();
@@ -95,6 +102,15 @@ void RouteRetriever::parseOneElement(JsonVariantConst &routeDoc)
   m_routeList.addRoute(route);
 }
 
+/**
+ * Same document for every instance; never modified after it is built
+ */
+const JsonDocument &RouteRetriever::getFilter()
+{
+  static const JsonDocument filter = constructFilter();
+  return filter;
+}
+
 JsonDocument RouteRetriever::constructFilter()
 {
   JsonDocument filter;
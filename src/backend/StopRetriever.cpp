@@ -38,8 +38,7 @@ StopRetriever::StopRetriever(APICaller *caller, float lat, float lon, float radi
 bool StopRetriever::retrieve()
 {
   m_stopList.clear();
-  JsonDocument filter = constructFilter();
-  return loopRequest(filter, STOP_KEY_NAME);
+  return loopRequest(getFilter(), STOP_KEY_NAME);
 }
 
 StopList StopRetriever::getStopList() const
@@ -68,12 +67,18 @@ void StopRetriever::parseOneElement(JsonVariantConst &stopInfo)
 
   // get info from stop
   Stop stop;
-  stop.onestopId = stopInfo["onestop_id"].as<std::string>();
+  stop.onestopId = StringInterner::intern(stopInfo["onestop_id"].as<const char *>());
   stop.name = stopInfo["stop_name"].as<std::string>();
 
   m_stopList.addStop(stop);
 }
 
+const JsonDocument &StopRetriever::getFilter()
+{
+  static const JsonDocument filter = constructFilter();
+  return filter;
+}
+
 JsonDocument StopRetriever::constructFilter()
 {
   // Create filter
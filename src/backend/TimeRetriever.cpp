@@ -7,6 +7,10 @@
 namespace
 {
   const char *TIME_URL = "pool.ntp.org";
+
+  static_assert(TimeRetriever::parseISO8601UTC("1970-01-01T00:00:00Z") == 0, "epoch");
+  static_assert(TimeRetriever::parseISO8601UTC("2024-02-29T12:34:56Z") == 1709210096, "leap day");
+  static_assert(TimeRetriever::parseISO8601UTC("2024-02-29 12:34:56Z") == -1, "malformed");
 }
 
 TimeRetriever::TimeRetriever() : m_startTimeSeconds{0}, m_startTimeUTC{0} {}
@@ -41,30 +45,11 @@ std::time_t TimeRetriever::espRetrieveTime()
   return timegmUTC(&timeinfo);
 }
 
+/**
+ * Interprets timeinfo as UTC, which mktime() can't do without swapping the TZ environment
+ */
 std::time_t TimeRetriever::timegmUTC(std::tm *timeinfo)
 {
-  std::time_t result;
-
-  // 1. Save the current TZ environment variable
-  char *tz_original = getenv("TZ");
-
-  // 2. Set the timezone to UTC
-  setenv("TZ", "", 1); // An empty string or "UTC0" means UTC
-  tzset();             // Apply the new timezone
-
-  // 3. Call mktime(), which now thinks the struct is in UTC
-  result = mktime(timeinfo);
-
-  // 4. Restore the original timezone
-  if (tz_original)
-  {
-    setenv("TZ", tz_original, 1);
-  }
-  else
-  {
-    unsetenv("TZ");
-  }
-  tzset(); // Apply the original timezone back
-
-  return result;
+  return daysFromCivil(timeinfo->tm_year + 1900, timeinfo->tm_mon + 1, timeinfo->tm_mday) * 86400 +
+         timeinfo->tm_hour * 3600 + timeinfo->tm_min * 60 + timeinfo->tm_sec;
 }
\ No newline at end of file
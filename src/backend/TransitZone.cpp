@@ -8,11 +8,20 @@
 #include "backend/DepartureRetriever.h"
 #include "backend/RouteRetriever.h"
 #include "backend/StopRetriever.h"
+#include "backend/ZoneCache.h"
 #include "types/Whitelist.h"
 #include "types/RouteList.h"
 #include "types/StopList.h"
 #include "types/DepartureList.h"
 
+namespace
+{
+  // routes and stops older than this are revalidated in the background
+  const std::time_t CACHE_TTL = 24 * 60 * 60; // s
+  // a failed revalidation is tried again after this long
+  const std::time_t REVALIDATE_RETRY_PERIOD = 60 * 60; // s
+}
+
 TransitZone::TransitZone(const std::string &name,
                          const float lat,
                          const float lon,
@@ -21,24 +30,83 @@ TransitZone::TransitZone(const std::string &name,
                          TimeRetriever *time,
                          const DepartureRetrieverConfig &config)
     : m_name{name}, m_lat{lat}, m_lon{lon}, m_radius{radius},
-      m_isValid{false}, m_isInitialized{false},
+      m_isValid{false}, m_isInitialized{false}, m_catalogsCheckedAt{0}, m_departuresFetchedMs{0},
       m_caller{caller}, m_time{time},
+      m_routeList{std::make_shared<RouteList>()},
+      m_stopList{std::make_shared<StopList>()},
       m_departureListRetriever{m_caller, m_time, config},
-      m_status{TransitZoneStatus::UNINITIALIZED} {}
+      m_status{TransitZoneStatus::UNINITIALIZED}
+{
+  m_departureListRetriever.setOnPublished(
+      [this]()
+      {
+        m_departuresFetchedMs = millis();
+        if (m_onDeparturesPublished)
+        {
+          m_onDeparturesPublished();
+        }
+      });
+}
 
 std::string TransitZone::getName() const { return m_name; }
-bool TransitZone::isInitialized() const { return m_isInitialized; }
+bool TransitZone::isInitialized() const { return m_isInitialized.load(std::memory_order_acquire); }
 bool TransitZone::isValid() const { return m_isValid; }
 float TransitZone::getLat() const { return m_lat; }
 float TransitZone::getLon() const { return m_lon; }
 float TransitZone::getRadius() const { return m_radius; }
-RouteList TransitZone::getRoutes() const { return m_routeList; }
-DepartureList TransitZone::getDepartures() const
+/**
+ * Current routes; safe to call from any task while revalidate() swaps them
+ */
+RouteListPtr TransitZone::getRoutes() const { return std::atomic_load(&m_routeList); }
+DepartureListPtr TransitZone::getDepartures() const
 {
   return m_departureListRetriever.getDepartureList();
 }
 Whitelist TransitZone::getWhitelist() const { return m_whitelist; }
 
+/**
+ * Whether routes and stops are older than the cache TTL, whether they came
+ * from flash or were downloaded while running
+ */
+bool TransitZone::needsRevalidation() const
+{
+  if (!isInitialized())
+    return false;
+  std::time_t age = m_time->getCurTime() - m_catalogsCheckedAt;
+  return age < 0 || age > CACHE_TTL;
+}
+
+/**
+ * Whether departures were last published less than maxAgeMs ago
+ */
+bool TransitZone::hasDeparturesNewerThan(const unsigned long maxAgeMs) const
+{
+  unsigned long fetchedMs = m_departuresFetchedMs;
+  return fetchedMs != 0 && millis() - fetchedMs <= maxAgeMs;
+}
+
+unsigned long TransitZone::getDeparturesFetchedMs() const { return m_departuresFetchedMs; }
+int TransitZone::getDueRequestCount(const bool allStops) const { return m_departureListRetriever.getDueRequestCount(allStops); }
+unsigned long TransitZone::msUntilDeparturesDue() const { return m_departureListRetriever.msUntilNextDue(); }
+bool TransitZone::hasPendingDepartures() const { return m_departureListRetriever.hasInFlight(); }
+
+/**
+ * Lets departures for several stops be fetched at once
+ */
+void TransitZone::setAsyncCaller(AsyncAPICaller *async)
+{
+  m_departureListRetriever.setAsyncCaller(async);
+}
+
+/**
+ * Called whenever new departures are published, possibly on an async
+ * worker. Set only while no departures are pending.
+ */
+void TransitZone::setOnDeparturesPublished(const DepartureListRetriever::PublishCallback &onPublished)
+{
+  m_onDeparturesPublished = onPublished;
+}
+
 void TransitZone::init()
 {
   init(Whitelist());
@@ -46,56 +114,142 @@ void TransitZone::init()
 
 /**
  * Re-initializes no matter what
+ *
+ * Routes and stops are read from the flash cache when possible; an expired
+ * entry is still used, and needsRevalidation() says so until revalidate()
+ * refreshes it.
+ * A cancelled download leaves the zone uninitialized.
  */
-void TransitZone::init(const Whitelist &whitelist)
+void TransitZone::init(const Whitelist &whitelist, const CancellationToken &cancel)
 {
   clearDepartures();
+  unsigned long startMs = millis();
 
-  RouteRetriever routeRetriever{m_caller, m_lat, m_lon, m_radius, whitelist};
-  StopRetriever stopRetriever{m_caller, m_lat, m_lon, m_radius, whitelist};
-
-  m_status = TransitZoneStatus::RETRIEVING_ROUTES;
-  if (routeRetriever.retrieve())
+  ZoneCache cache{m_lat, m_lon, m_radius, whitelist};
+  RouteList routes;
+  StopList stops;
+  APICaller::ValidatorMap validators;
+  std::time_t savedAt;
+  if (cache.load(routes, stops, validators, savedAt))
   {
-    m_routeList = routeRetriever.getRouteList();
+    setCatalogs(std::move(routes), std::move(stops));
+    m_catalogValidators = std::move(validators);
+    m_catalogsCheckedAt = savedAt;
+    finishInit(whitelist);
+
+    Serial.print((m_name + ": warm start from cache in ").c_str());
+    Serial.print(millis() - startMs);
+    Serial.println(" ms");
+    return;
   }
-  else
+
+  bool unchanged;
+  if (!retrieveCatalogs(whitelist, routes, stops, cancel, CacheValidation::RECORD, validators, unchanged))
   {
     m_isValid = false;
     return;
   }
+  setCatalogs(std::move(routes), std::move(stops));
+  m_catalogValidators = std::move(validators);
+  m_catalogsCheckedAt = m_time->getCurTime();
+  cache.save(*getRoutes(), *getStops(), m_catalogValidators, m_catalogsCheckedAt);
+  finishInit(whitelist);
 
-  m_status = TransitZoneStatus::RETRIEVING_STOPS;
-  if (stopRetriever.retrieve())
-  {
-    m_stopList = stopRetriever.getStopList();
-  }
-  else
+  Serial.print((m_name + ": cold start in ").c_str());
+  Serial.print(millis() - startMs);
+  Serial.println(" ms");
+}
+
+/**
+ * Re-downloads routes and stops and refreshes the cache entry
+ *
+ * The requests are conditional, so catalogs that have not changed since
+ * they were downloaded cost a 304 each. The current routes and stops are
+ * kept if the download fails.
+ */
+void TransitZone::revalidate(const CancellationToken &cancel)
+{
+  if (!isInitialized())
+    return;
+
+  unsigned long startMs = millis();
+
+  // the caller may have dropped them for other zones' pages since
+  m_caller->importValidators(m_catalogValidators);
+
+  RouteList routes;
+  StopList stops;
+  APICaller::ValidatorMap validators;
+  bool unchanged;
+  if (!retrieveCatalogs(m_whitelist, routes, stops, cancel, CacheValidation::REVALIDATE, validators, unchanged))
   {
-    m_isValid = false;
+    m_status = TransitZoneStatus::IDLE;
+    if (cancel.isCancelled())
+      return;
+    m_catalogsCheckedAt = m_time->getCurTime() - CACHE_TTL + REVALIDATE_RETRY_PERIOD;
+    Serial.println((m_name + ": revalidation failed, keeping cached routes and stops").c_str());
     return;
   }
 
-  m_departureListRetriever.init(m_routeList, m_stopList);
-  m_isValid = !m_routeList.empty();
-
+  if (!unchanged)
+  {
+    setCatalogs(std::move(routes), std::move(stops));
+    m_departureListRetriever.init(getRoutes(), getStops());
+    m_isValid = !getRoutes()->empty();
+  }
+  m_catalogValidators = std::move(validators);
+  m_catalogsCheckedAt = m_time->getCurTime();
+  // rewritten either way, so the entry's age starts over
+  ZoneCache{m_lat, m_lon, m_radius, m_whitelist}.save(*getRoutes(), *getStops(), m_catalogValidators, m_catalogsCheckedAt);
   m_status = TransitZoneStatus::IDLE;
-  m_whitelist = whitelist;
-  m_isInitialized = true;
+
+  Serial.print((m_name + (unchanged ? ": revalidated (unchanged) in " : ": revalidated in ")).c_str());
+  Serial.print(millis() - startMs);
+  Serial.println(" ms");
 }
 
-void TransitZone::callDeparturesAPI()
+/**
+ * Blocks until departures are fetched, or until soon after cancel is cancelled
+ *
+ * Only stops that are due are fetched unless allStops is set.
+ */
+void TransitZone::callDeparturesAPI(const CancellationToken &cancel, const bool allStops)
 {
   if (!isInitialized())
     return;
 
   m_status = TransitZoneStatus::RETRIEVING_DEPARTURES;
-  m_departureListRetriever.retrieve();
+  m_departureListRetriever.retrieve(cancel, allStops);
   m_status = TransitZoneStatus::IDLE;
 }
 
+/**
+ * Hands the due stops to the async caller and returns; departures are
+ * published batch by batch as they land. Without workers, blocks like
+ * callDeparturesAPI().
+ */
+void TransitZone::requestDepartures(const CancellationToken &cancel, const bool allStops)
+{
+  if (!isInitialized())
+    return;
+
+  if (!m_departureListRetriever.retrieveAsync(allStops))
+  {
+    callDeparturesAPI(cancel, allStops);
+  }
+}
+
+/**
+ * Returns once no departures requested by requestDepartures() are pending
+ */
+void TransitZone::cancelPendingDepartures()
+{
+  m_departureListRetriever.cancelInFlight();
+}
+
 void TransitZone::clearDepartures()
 {
+  m_departuresFetchedMs = 0;
   m_departureListRetriever.clear();
 }
 
@@ -113,12 +267,79 @@ void TransitZone::debugPrint()
   Serial.print(" radius=");
   Serial.println(getRadius(), 6);
 
-  getRoutes().debugPrintAllRoutes();
-  getStops().debugPrintAllStops();
-  getDepartures().debugPrintAllDepartures();
+  getRoutes()->debugPrintAllRoutes();
+  getStops()->debugPrintAllStops();
+  getDepartures()->debugPrintAllDepartures();
+}
+
+void TransitZone::debugPrintRefreshStats() const
+{
+  Serial.print("--- ");
+  Serial.print(m_name.c_str());
+  Serial.println(" departures ---");
+  m_departureListRetriever.debugPrintStats();
+}
+
+StopListPtr TransitZone::getStops() const
+{
+  return std::atomic_load(&m_stopList);
 }
 
-StopList TransitZone::getStops() const
+/**
+ * Swaps in new catalogs; readers keep whichever lists they already hold
+ */
+void TransitZone::setCatalogs(RouteList &&routes, StopList &&stops)
 {
-  return m_stopList;
+  std::atomic_store(&m_routeList, RouteListPtr(std::make_shared<const RouteList>(std::move(routes))));
+  std::atomic_store(&m_stopList, StopListPtr(std::make_shared<const StopList>(std::move(stops))));
+}
+
+/**
+ * With REVALIDATE, a catalog that answers 304 is copied from the current
+ * one; unchanged is set if both did. validators gets those of every page
+ * requested, for the next revalidation.
+ */
+bool TransitZone::retrieveCatalogs(const Whitelist &whitelist,
+                                   RouteList &routes,
+                                   StopList &stops,
+                                   const CancellationToken &cancel,
+                                   const CacheValidation validation,
+                                   APICaller::ValidatorMap &validators,
+                                   bool &unchanged)
+{
+  RouteRetriever routeRetriever{m_caller, m_lat, m_lon, m_radius, whitelist};
+  StopRetriever stopRetriever{m_caller, m_lat, m_lon, m_radius, whitelist};
+  routeRetriever.setCancellationToken(cancel);
+  stopRetriever.setCancellationToken(cancel);
+  routeRetriever.setCacheValidation(validation);
+  stopRetriever.setCacheValidation(validation);
+
+  m_status = TransitZoneStatus::RETRIEVING_ROUTES;
+  if (!routeRetriever.retrieve())
+    return false;
+  routes = routeRetriever.isUnchanged() ? *getRoutes() : routeRetriever.getRouteList();
+
+  m_status = TransitZoneStatus::RETRIEVING_STOPS;
+  if (!stopRetriever.retrieve())
+    return false;
+  stops = stopRetriever.isUnchanged() ? *getStops() : stopRetriever.getStopList();
+
+  std::vector<std::string> endpoints = routeRetriever.getPageEndpoints();
+  std::vector<std::string> stopEndpoints = stopRetriever.getPageEndpoints();
+  endpoints.insert(endpoints.end(), stopEndpoints.begin(), stopEndpoints.end());
+  validators = m_caller->exportValidators(endpoints);
+
+  unchanged = routeRetriever.isUnchanged() && stopRetriever.isUnchanged();
+  return true;
+}
+
+void TransitZone::finishInit(const Whitelist &whitelist)
+{
+  RouteListPtr routes = getRoutes();
+  m_departureListRetriever.init(routes, getStops());
+  m_isValid = !routes->empty();
+
+  m_status = TransitZoneStatus::IDLE;
+  m_whitelist = whitelist;
+  m_isInitialized.store(true, std::memory_order_release);
 }
\ No newline at end of file
@@ -0,0 +1,295 @@
+#include "backend/ZoneCache.h"
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <string>
+#include <vector>
+
+#include "types/TransitTypes.h"
+
+namespace
+{
+  const uint32_t CACHE_MAGIC = 0x545A4331; // "TZC1"
+  const uint16_t CACHE_VERSION = 3; // 2 added the catalog validators; 3 dropped the API key from them
+  const char *CACHE_PATH_PREFIX = "/zone_";
+  const char *CACHE_PATH_SUFFIX = ".bin";
+  const char *CACHE_TMP_SUFFIX = ".tmp";
+
+  const uint32_t FNV_OFFSET_BASIS = 2166136261u;
+  const uint32_t FNV_PRIME = 16777619u;
+
+  bool fsMounted = false;
+
+  // an entry as read, before any of it is interned
+  struct CachedRoute
+  {
+    std::string onestopId, name, agencyOnestopId;
+    int32_t lineColor, textColor;
+  };
+
+  struct CachedStop
+  {
+    std::string onestopId, name;
+  };
+
+  uint32_t fnv1a(uint32_t hash, const void *data, size_t len)
+  {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < len; i++)
+    {
+      hash ^= bytes[i];
+      hash *= FNV_PRIME;
+    }
+    return hash;
+  }
+
+  // all integers are written little-endian, which is the ESP32's native order
+  template <typename T>
+  bool writeValue(File &file, const T value)
+  {
+    return file.write(reinterpret_cast<const uint8_t *>(&value), sizeof(T)) == sizeof(T);
+  }
+
+  template <typename T>
+  bool readValue(File &file, T &value)
+  {
+    return file.read(reinterpret_cast<uint8_t *>(&value), sizeof(T)) == sizeof(T);
+  }
+
+  bool writeString(File &file, const std::string &str)
+  {
+    uint16_t len = str.length();
+    return writeValue(file, len) &&
+           file.write(reinterpret_cast<const uint8_t *>(str.data()), len) == len;
+  }
+
+  bool readString(File &file, std::string &str)
+  {
+    uint16_t len;
+    if (!readValue(file, len))
+      return false;
+    str.resize(len);
+    return file.read(reinterpret_cast<uint8_t *>(&str[0]), len) == len;
+  }
+}
+
+ZoneCache::ZoneCache(const float lat, const float lon, const float radius, const Whitelist &whitelist)
+{
+  char key[9];
+  snprintf(key, sizeof(key), "%08lx", static_cast<unsigned long>(hashKey(lat, lon, radius, whitelist)));
+  m_path = std::string(CACHE_PATH_PREFIX) + key + CACHE_PATH_SUFFIX;
+}
+
+bool ZoneCache::begin()
+{
+  fsMounted = LittleFS.begin(true); // formats on first use
+  if (!fsMounted)
+  {
+    Serial.println("Zone cache: could not mount LittleFS");
+  }
+  return fsMounted;
+}
+
+/**
+ * Returns false if there is no usable entry; the outputs are only written on success
+ *
+ * The whole entry is read and checked before any id is interned, since
+ * interned strings are never freed.
+ */
+bool ZoneCache::load(RouteList &routes,
+                     StopList &stops,
+                     APICaller::ValidatorMap &validators,
+                     std::time_t &savedAt) const
+{
+  if (!fsMounted || !LittleFS.exists(m_path.c_str()))
+    return false;
+
+  File file = LittleFS.open(m_path.c_str(), "r");
+  if (!file)
+    return false;
+
+  uint32_t magic;
+  uint16_t version;
+  int64_t timestamp;
+  if (!readValue(file, magic) || magic != CACHE_MAGIC ||
+      !readValue(file, version) || version != CACHE_VERSION ||
+      !readValue(file, timestamp))
+  {
+    file.close();
+    return false;
+  }
+
+  std::vector<CachedRoute> cachedRoutes;
+  uint16_t numRoutes;
+  bool ok = readValue(file, numRoutes);
+  for (int i = 0; ok && i < numRoutes; i++)
+  {
+    CachedRoute route;
+    ok = readString(file, route.onestopId) &&
+         readString(file, route.name) &&
+         readValue(file, route.lineColor) &&
+         readValue(file, route.textColor) &&
+         readString(file, route.agencyOnestopId);
+    if (ok)
+      cachedRoutes.push_back(std::move(route));
+  }
+
+  std::vector<CachedStop> cachedStops;
+  uint16_t numStops;
+  ok = ok && readValue(file, numStops);
+  for (int i = 0; ok && i < numStops; i++)
+  {
+    CachedStop stop;
+    ok = readString(file, stop.onestopId) && readString(file, stop.name);
+    if (ok)
+      cachedStops.push_back(std::move(stop));
+  }
+
+  APICaller::ValidatorMap loadedValidators;
+  uint16_t numValidators;
+  ok = ok && readValue(file, numValidators);
+  for (int i = 0; ok && i < numValidators; i++)
+  {
+    std::string endpoint;
+    APICaller::Validators entry;
+    uint32_t bodyBytes;
+    ok = readString(file, endpoint) &&
+         readString(file, entry.etag) &&
+         readString(file, entry.lastModified) &&
+         readString(file, entry.next) &&
+         readValue(file, bodyBytes);
+    entry.bodyBytes = bodyBytes;
+    if (ok)
+      loadedValidators[endpoint] = entry;
+  }
+  // anything after the validators means the counts were wrong
+  ok = ok && file.available() == 0;
+  file.close();
+
+  if (!ok)
+  {
+    Serial.println(("Zone cache: corrupt entry " + m_path).c_str());
+    remove();
+    return false;
+  }
+
+  RouteList loadedRoutes;
+  for (const CachedRoute &cached : cachedRoutes)
+  {
+    Route route;
+    route.onestopId = StringInterner::intern(cached.onestopId);
+    route.name = cached.name;
+    route.lineColor = cached.lineColor;
+    route.textColor = cached.textColor;
+    route.agencyOnestopId = StringInterner::intern(cached.agencyOnestopId);
+    loadedRoutes.addRoute(route);
+  }
+
+  StopList loadedStops;
+  for (const CachedStop &cached : cachedStops)
+  {
+    Stop stop;
+    stop.onestopId = StringInterner::intern(cached.onestopId);
+    stop.name = cached.name;
+    loadedStops.addStop(stop);
+  }
+
+  routes = loadedRoutes;
+  stops = loadedStops;
+  validators = loadedValidators;
+  savedAt = static_cast<std::time_t>(timestamp);
+  return true;
+}
+
+/**
+ * Writes to a temporary file first and renames it over the entry, so a
+ * reset at any point leaves either the old entry or the new one
+ */
+bool ZoneCache::save(const RouteList &routes,
+                     const StopList &stops,
+                     const APICaller::ValidatorMap &validators,
+                     const std::time_t savedAt) const
+{
+  if (!fsMounted)
+    return false;
+
+  std::string tmpPath = m_path + CACHE_TMP_SUFFIX;
+  File file = LittleFS.open(tmpPath.c_str(), "w");
+  if (!file)
+    return false;
+
+  std::vector<Route> allRoutes = routes.getDisplayRouteList();
+  std::vector<Stop> allStops = stops.getAllStops();
+
+  bool ok = writeValue(file, CACHE_MAGIC) &&
+            writeValue(file, CACHE_VERSION) &&
+            writeValue(file, static_cast<int64_t>(savedAt)) &&
+            writeValue(file, static_cast<uint16_t>(allRoutes.size()));
+  for (int i = 0; ok && i < allRoutes.size(); i++)
+  {
+    const Route &route = allRoutes[i];
+    ok = writeString(file, StringInterner::str(route.onestopId)) &&
+         writeString(file, route.name) &&
+         writeValue(file, static_cast<int32_t>(route.lineColor)) &&
+         writeValue(file, static_cast<int32_t>(route.textColor)) &&
+         writeString(file, StringInterner::str(route.agencyOnestopId));
+  }
+
+  ok = ok && writeValue(file, static_cast<uint16_t>(allStops.size()));
+  for (int i = 0; ok && i < allStops.size(); i++)
+  {
+    ok = writeString(file, StringInterner::str(allStops[i].onestopId)) && writeString(file, allStops[i].name);
+  }
+
+  ok = ok && writeValue(file, static_cast<uint16_t>(validators.size()));
+  for (auto it = validators.begin(); ok && it != validators.end(); ++it)
+  {
+    ok = writeString(file, it->first) &&
+         writeString(file, it->second.etag) &&
+         writeString(file, it->second.lastModified) &&
+         writeString(file, it->second.next) &&
+         writeValue(file, static_cast<uint32_t>(it->second.bodyBytes));
+  }
+  file.close();
+
+  if (!ok)
+  {
+    LittleFS.remove(tmpPath.c_str());
+    return false;
+  }
+
+  // LittleFS renames over an existing file atomically, so the old entry
+  // stays readable until the new one replaces it
+  if (!LittleFS.rename(tmpPath.c_str(), m_path.c_str()))
+  {
+    LittleFS.remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+void ZoneCache::remove() const
+{
+  if (fsMounted)
+    LittleFS.remove(m_path.c_str());
+}
+
+uint32_t ZoneCache::hashKey(const float lat, const float lon, const float radius, const Whitelist &whitelist)
+{
+  uint32_t hash = FNV_OFFSET_BASIS;
+  hash = fnv1a(hash, &lat, sizeof(lat));
+  hash = fnv1a(hash, &lon, sizeof(lon));
+  hash = fnv1a(hash, &radius, sizeof(radius));
+
+  bool active = whitelist.isActive();
+  hash = fnv1a(hash, &active, sizeof(active));
+  if (active)
+  {
+    // items are sorted, so the key does not depend on insertion order
+    for (const std::string &item : whitelist.getItems())
+    {
+      hash = fnv1a(hash, item.data(), item.length() + 1); // include terminator as separator
+    }
+  }
+  return hash;
+}
@@ -0,0 +1,179 @@
+#include "backend/ZoneScheduler.h"
+
+#include <Arduino.h>
+#include <algorithm>
+#include <climits>
+
+#include "backend/RequestScheduler.h"
+
+ZoneScheduler::ZoneScheduler(const int numZones,
+                             const unsigned long shownPeriodMs,
+                             const unsigned long hiddenPeriodMs)
+    : m_zones(numZones, ZoneState{{0, 0, 0, 0}, 1, false, false, false, 0}),
+      m_shownPeriod{shownPeriodMs}, m_hiddenPeriod{hiddenPeriodMs} {}
+
+/**
+ * Zone to refresh now, or -1 if none is due or RequestScheduler does not
+ * have budget for its cost yet. Nothing is spent here.
+ *
+ * waitMs is set to how long until a zone could be due; it is 0 when a zone is returned.
+ */
+int ZoneScheduler::next(const int shownIdx, unsigned long &waitMs)
+{
+  int best = -1;
+  unsigned long bestAge = 0;
+  waitMs = m_hiddenPeriod;
+  for (int i = 0; i < m_zones.size(); i++)
+  {
+    bool shown = i == shownIdx;
+    unsigned long dueMs = msUntilDue(i, shown);
+    if (dueMs > 0)
+    {
+      waitMs = std::min(waitMs, dueMs);
+      continue;
+    }
+
+    // forced and on-screen zones jump the queue; otherwise stalest first
+    unsigned long age = getStalenessMs(i);
+    if (m_zones[i].forced)
+      age = ULONG_MAX;
+    else if (shown)
+      age = ULONG_MAX - 1;
+    if (best == -1 || age > bestAge)
+    {
+      best = i;
+      bestAge = age;
+    }
+  }
+
+  if (best == -1)
+    return -1;
+
+  // with one zone there is nothing to keep budget back for; its requests are still paced
+  // a refresh bigger than the whole bucket waits for a full one
+  unsigned long budgetWaitMs = m_zones.size() > 1 ? RequestScheduler::msUntilAvailable(m_zones[best].cost) : 0;
+  if (budgetWaitMs > 0)
+  {
+    waitMs = budgetWaitMs;
+    return -1;
+  }
+
+  m_zones[best].forced = false;
+  waitMs = 0;
+  return best;
+}
+
+/**
+ * Makes a zone due now; the budget still applies
+ */
+void ZoneScheduler::force(const int idx)
+{
+  m_zones[idx].forced = true;
+}
+
+void ZoneScheduler::setCost(const int idx, const int requests)
+{
+  m_zones[idx].cost = std::max(requests, 1);
+}
+
+/**
+ * For zones that decide their own refresh times, such as per-stop schedules
+ */
+void ZoneScheduler::setDueIn(const int idx, const unsigned long ms)
+{
+  m_zones[idx].adaptive = true;
+  m_zones[idx].dueAtMs = millis() + ms;
+}
+
+/**
+ * For zones whose fetches finish on another task; one in flight is not due
+ */
+void ZoneScheduler::setInFlight(const int idx, const bool inFlight)
+{
+  m_zones[idx].inFlight = inFlight;
+}
+
+/**
+ * For a zone whose departures were fetched before the scheduler existed
+ */
+void ZoneScheduler::seed(const int idx, const unsigned long fetchedMs)
+{
+  m_zones[idx].stats.lastFetchMs = fetchedMs;
+}
+
+/**
+ * A fetch may finish on another task; it is recorded with the time it finished,
+ * whenever the retrieval task gets to it
+ */
+void ZoneScheduler::recordFetch(const int idx, const unsigned long startMs, const unsigned long finishedMs)
+{
+  ZoneFetchStats &stats = m_zones[idx].stats;
+  stats.lastFetchMs = finishedMs;
+  stats.lastLatencyMs = finishedMs - startMs;
+  stats.totalLatencyMs += stats.lastLatencyMs;
+  stats.fetches++;
+}
+
+ZoneFetchStats ZoneScheduler::getStats(const int idx) const
+{
+  return m_zones[idx].stats;
+}
+
+/**
+ * Age of a zone's departures; ULONG_MAX if never fetched
+ */
+unsigned long ZoneScheduler::getStalenessMs(const int idx) const
+{
+  unsigned long fetchedMs = m_zones[idx].stats.lastFetchMs;
+  if (fetchedMs == 0)
+    return ULONG_MAX;
+  return millis() - fetchedMs;
+}
+
+void ZoneScheduler::debugPrint(const std::vector<std::string> &names) const
+{
+  Serial.println(F("--- Zone Scheduler ---"));
+  for (int i = 0; i < m_zones.size() && i < names.size(); i++)
+  {
+    const ZoneFetchStats &stats = m_zones[i].stats;
+    Serial.print(names[i].c_str());
+    Serial.print(F(": staleness (s) "));
+    if (stats.lastFetchMs == 0)
+      Serial.print(F("never"));
+    else
+      Serial.print(getStalenessMs(i) / 1000);
+    Serial.print(F(", latency (ms) last "));
+    Serial.print(stats.lastLatencyMs);
+    Serial.print(F(" avg "));
+    Serial.print(stats.fetches == 0 ? 0 : stats.totalLatencyMs / stats.fetches);
+    Serial.print(F(", fetches "));
+    Serial.print(stats.fetches);
+    Serial.print(F(", cost "));
+    Serial.println(m_zones[i].cost);
+  }
+}
+
+/**
+ * 0 if the zone is due now
+ */
+unsigned long ZoneScheduler::msUntilDue(const int idx, const bool shown) const
+{
+  // its landing wakes the retrieval task, so this is only a fallback
+  if (m_zones[idx].inFlight)
+    return m_hiddenPeriod;
+  if (m_zones[idx].forced || m_zones[idx].stats.lastFetchMs == 0)
+    return 0;
+
+  unsigned long age = getStalenessMs(idx);
+  unsigned long hiddenWait = age >= m_hiddenPeriod ? 0 : m_hiddenPeriod - age;
+  if (m_zones[idx].adaptive)
+  {
+    long dueWait = static_cast<long>(m_zones[idx].dueAtMs - millis());
+    unsigned long wait = dueWait <= 0 ? 0 : dueWait;
+    return shown ? wait : std::max(wait, hiddenWait);
+  }
+
+  if (!shown)
+    return hiddenWait;
+  return age >= m_shownPeriod ? 0 : m_shownPeriod - age;
+}
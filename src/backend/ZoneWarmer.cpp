@@ -0,0 +1,130 @@
+#include "backend/ZoneWarmer.h"
+
+#include <Arduino.h>
+
+namespace
+{
+  const int TASK_STACK_SIZE = 8192;
+  const int TASK_PRIORITY = 1;
+
+  // warmed departures younger than this are not fetched again
+  const unsigned long FRESH_DEPARTURES_AGE = 30000; // ms
+}
+
+ZoneWarmer::ZoneWarmer(const Whitelist &whitelist) : m_whitelist{whitelist} {}
+
+void ZoneWarmer::begin()
+{
+  if (m_taskHandle != NULL)
+    return;
+
+  xTaskCreate(taskRunner, "ZoneWarmer", TASK_STACK_SIZE, this, TASK_PRIORITY, &m_taskHandle);
+}
+
+/**
+ * Replaces the zones to warm, in order. Work on zones from an earlier
+ * call is abandoned at its next safe point, unless that zone comes first.
+ */
+void ZoneWarmer::warm(const std::vector<TransitZone *> &zones)
+{
+  if (m_taskHandle == NULL)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(m_pendingMtx);
+    if (m_current != nullptr && !zones.empty() && zones.front() == m_current)
+    {
+      m_pending.assign(zones.begin() + 1, zones.end());
+    }
+    else
+    {
+      m_pending = zones;
+      m_cancel.cancel();
+    }
+  }
+  xTaskNotifyGive(m_taskHandle);
+}
+
+/**
+ * Abandons all warming and blocks until the task no longer uses any zone
+ */
+void ZoneWarmer::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_pendingMtx);
+    m_pending.clear();
+    m_cancel.cancel();
+  }
+
+  unsigned long startMs = millis();
+  std::lock_guard<std::mutex> work(m_workMtx);
+  Serial.print("Zone warmer stopped in ");
+  Serial.print(millis() - startMs);
+  Serial.println(" ms");
+}
+
+void ZoneWarmer::taskRunner(void *pvParameters)
+{
+  ZoneWarmer *inst = static_cast<ZoneWarmer *>(pvParameters);
+  inst->taskLoop();
+}
+
+void ZoneWarmer::taskLoop()
+{
+  while (true)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    std::lock_guard<std::mutex> work(m_workMtx);
+    TransitZone *zone;
+    while (takeNext(zone))
+    {
+      warmZone(zone);
+      finishCurrent();
+    }
+  }
+}
+
+/**
+ * Pops the next zone to warm, and clears any cancellation meant for the previous one
+ */
+bool ZoneWarmer::takeNext(TransitZone *&zone)
+{
+  std::lock_guard<std::mutex> lock(m_pendingMtx);
+  if (m_pending.empty())
+    return false;
+
+  zone = m_pending.front();
+  m_pending.erase(m_pending.begin());
+  m_current = zone;
+  m_cancel.reset();
+  return true;
+}
+
+void ZoneWarmer::finishCurrent()
+{
+  std::lock_guard<std::mutex> lock(m_pendingMtx);
+  m_current = nullptr;
+}
+
+void ZoneWarmer::warmZone(TransitZone *zone)
+{
+  unsigned long startMs = millis();
+  if (!zone->isInitialized())
+  {
+    zone->init(m_whitelist, m_cancel);
+  }
+  if (!m_cancel.isCancelled() && zone->isInitialized() && !zone->hasDeparturesNewerThan(FRESH_DEPARTURES_AGE))
+  {
+    zone->callDeparturesAPI(m_cancel);
+  }
+
+  if (m_cancel.isCancelled())
+  {
+    Serial.println((zone->getName() + ": warm-up abandoned").c_str());
+    return;
+  }
+  Serial.print((zone->getName() + ": warmed in ").c_str());
+  Serial.print(millis() - startMs);
+  Serial.println(" ms");
+}
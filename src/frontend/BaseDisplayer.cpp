@@ -14,4 +14,35 @@ uint16_t BaseDisplayer::hexToRGB565(uint32_t hexColor)
 
   // Combine the components into a single 16-bit RGB565 value
   return (r5 << 11) | (g6 << 5) | b5;
+}
+
+FrameStats BaseDisplayer::getFrameStats() const
+{
+  return m_frameStats;
+}
+
+void BaseDisplayer::debugPrintFrameStats(const char *name) const
+{
+  Serial.print(name);
+  Serial.print(F(" frames: "));
+  Serial.print(m_frameStats.frames);
+  Serial.print(F(", avg us: "));
+  Serial.print(m_frameStats.frames == 0 ? 0 : m_frameStats.totalMicros / m_frameStats.frames);
+  Serial.print(F(", max us: "));
+  Serial.print(m_frameStats.maxMicros);
+  Serial.print(F(", last us: "));
+  Serial.println(m_frameStats.lastMicros);
+}
+
+/**
+ * Call at the end of a draw with micros() from its start
+ */
+void BaseDisplayer::recordFrame(const unsigned long startMicros)
+{
+  unsigned long elapsed = micros() - startMicros;
+  m_frameStats.frames++;
+  m_frameStats.totalMicros += elapsed;
+  m_frameStats.lastMicros = elapsed;
+  if (elapsed > m_frameStats.maxMicros)
+    m_frameStats.maxMicros = elapsed;
 }
\ No newline at end of file
@@ -23,17 +23,29 @@ namespace
   const int MAX_NUM_DEPARTURES_TO_DISPLAY = 5;
 }
 
-DeparturesDisplayer::DeparturesDisplayer(TFT_eSPI *tft, const uint8_t *fontRegular)
-    : m_tft{tft}, m_fontRegular{fontRegular}, m_lastUpdated{0} {}
+DeparturesDisplayer::DeparturesDisplayer(TFT_eSPI *tft, FontManager *fonts)
+    : m_tft{tft}, m_fonts{fonts}, m_lastUpdated{0},
+      m_rows(MAX_NUM_DEPARTURES_TO_DISPLAY), m_retainedValid{false}, m_showingEmpty{false}, m_paintStats{} {}
 
 /**
  * @brief Clears the entire area where departures are drawn.
  */
 void DeparturesDisplayer::drawBlankDepartureSpace()
 {
-  // Calculate the total height of the 5 rows plus spacing to clear the exact area
-  int clearHeight = (5 * (DEPARTURES_ROW_HEIGHT + DEPARTURES_ROW_SPACING));
-  m_tft->fillRect(0, DEPARTURES_START_Y, Constants::DISPLAY_WIDTH, clearHeight, TFT_BLACK);
+  m_tft->fillRect(0, DEPARTURES_START_Y, Constants::DISPLAY_WIDTH, getRegionHeight(), TFT_BLACK);
+}
+
+int DeparturesDisplayer::getRegionY()
+{
+  return DEPARTURES_START_Y;
+}
+
+/**
+ * Total height of the 5 rows plus spacing
+ */
+int DeparturesDisplayer::getRegionHeight()
+{
+  return 5 * (DEPARTURES_ROW_HEIGHT + DEPARTURES_ROW_SPACING);
 }
 
 /**
@@ -46,128 +58,243 @@ void DeparturesDisplayer::setDepartures(const std::vector<DisplayDeparture> &dep
   m_departures = departures;
 }
 
+void DeparturesDisplayer::setDepartures(std::vector<DisplayDeparture> &&departures)
+{
+  m_lastUpdated = millis();
+  m_departures = std::move(departures);
+}
+
+/**
+ * Forget what is on screen so the next cycle repaints everything
+ */
+void DeparturesDisplayer::invalidate()
+{
+  m_retainedValid = false;
+}
+
+/**
+ * Bands repainted by the last cycle
+ */
+const std::vector<DirtyBand> &DeparturesDisplayer::getDirtyBands() const
+{
+  return m_dirtyBands;
+}
+
+PaintStats DeparturesDisplayer::getPaintStats() const
+{
+  return m_paintStats;
+}
+
+void DeparturesDisplayer::debugPrintPaintStats() const
+{
+  Serial.print(F("Departures repaints full: "));
+  Serial.print(m_paintStats.fullRepaints);
+  Serial.print(F(", partial: "));
+  Serial.print(m_paintStats.partialRepaints);
+  Serial.print(F(", last px: "));
+  Serial.print(m_paintStats.lastPixels);
+  Serial.print(F(", total px: "));
+  Serial.println(m_paintStats.totalPixels);
+}
+
 /**
  * @brief Draws the departure list to the screen. Call this after setDepartures.
+ *
+ * Only cells that differ from what is already on screen are repainted.
  */
 void DeparturesDisplayer::cycle()
 {
-  // First, clear the area of the old list
-  drawBlankDepartureSpace();
+  unsigned long frameStart = micros();
+  m_dirtyBands.clear();
+  m_paintStats.lastPixels = 0;
 
-  // Load the custom font for drawing.
-  // This must match the name of the .vlw file you created.
-  m_tft->loadFont(m_fontRegular);
+  // Load the custom font for drawing; only parsed on first use
+  m_fonts->useRegular(m_tft);
 
   updateDepartureMins();
 
   // Serial.println(m_tft->textWidth("Yellow-N"));
   if (m_departures.empty() || m_departures[0].mins >= 100)
   {
-    m_tft->setTextDatum(MC_DATUM);
-    m_tft->setTextColor(TFT_WHITE);
+    if (!m_showingEmpty || !m_retainedValid)
+    {
+      drawBlankDepartureSpace();
 
-    // Calculate the center of the departures area to display the message
-    int centerX = Constants::DISPLAY_WIDTH / 2;
-    int centerY = DEPARTURES_START_Y + (Constants::DISPLAY_HEIGHT - DEPARTURES_START_Y) / 2;
+      m_tft->setTextDatum(MC_DATUM);
+      m_tft->setTextColor(TFT_WHITE);
 
-    m_tft->drawString("No departures found", centerX, centerY);
-    m_tft->unloadFont();
+      // Calculate the center of the departures area to display the message
+      int centerX = Constants::DISPLAY_WIDTH / 2;
+      int centerY = DEPARTURES_START_Y + (Constants::DISPLAY_HEIGHT - DEPARTURES_START_Y) / 2;
+
+      m_tft->drawString("No departures found", centerX, centerY);
+
+      m_dirtyBands.push_back({DEPARTURES_START_Y, getRegionHeight()});
+      m_paintStats.lastPixels = Constants::DISPLAY_WIDTH * getRegionHeight();
+      m_paintStats.fullRepaints++;
+    }
+    m_rows.assign(MAX_NUM_DEPARTURES_TO_DISPLAY, RowState());
+    m_showingEmpty = true;
+    m_retainedValid = true;
+    m_paintStats.totalPixels += m_paintStats.lastPixels;
+    recordFrame(frameStart);
     return;
   }
 
+  bool fullRepaint = m_showingEmpty || !m_retainedValid;
+  if (fullRepaint)
+  {
+    drawBlankDepartureSpace();
+    m_rows.assign(MAX_NUM_DEPARTURES_TO_DISPLAY, RowState());
+    m_dirtyBands.push_back({DEPARTURES_START_Y, getRegionHeight()});
+    m_paintStats.lastPixels += Constants::DISPLAY_WIDTH * getRegionHeight();
+  }
+  m_showingEmpty = false;
+  m_retainedValid = true;
+
   // 1. Calculate the width of the widest possible minutes string to reserve that space.
   int maxMinsTextWidth = m_tft->textWidth("99 min");
   // 2. Calculate the available space for the direction text dynamically.
   int maxDirectionWidth = COL_MINS_X - COL_DIRECTION_X - maxMinsTextWidth - 15; // 15px gap for safety
+  int minsCellX = COL_DIRECTION_X + maxDirectionWidth + 1;
 
   // Determine how many departures to show (up to a maximum of 5)
   int numToDisplay = min((int)m_departures.size(), MAX_NUM_DEPARTURES_TO_DISPLAY);
 
-  for (int i = 0; i < numToDisplay; i++)
+  bool reachedEnd = false;
+  int rowsChanged = 0;
+  for (int i = 0; i < MAX_NUM_DEPARTURES_TO_DISPLAY; i++)
   {
-    DisplayDeparture dep = m_departures[i];
-    if (dep.mins >= 100)
-      break; // don't render > 100 mins
-
-    // Calculate the Y position for the top of the current row
-    int currentY = DEPARTURES_START_Y + (i * (DEPARTURES_ROW_HEIGHT + DEPARTURES_ROW_SPACING));
-    // Calculate the vertical center for text alignment
-    int textY = currentY + DEPARTURES_ROW_HEIGHT / 2 + 2; // +2px for vertical text centering with VLW fonts
-
-    // --- Column 1: Line Name (Constrained Width) ---
-    // Calculate the ideal width with padding
-    int idealWidth = m_tft->textWidth(dep.line.c_str()) + Constants::DISPLAY_ROUTE_PADDING;
-    // Constrain the button width to the maximum allowed
-    int buttonWidth = min(idealWidth, DEPARTURES_MAX_LINE_BUTTON_WIDTH);
-    // Determine the available space for text inside the constrained button
-    int textSpace = buttonWidth - DEPARTURES_MIN_PADDING;
-    // Get the final text, truncated if necessary
-    std::string lineText = truncateText(dep.line.c_str(), textSpace);
-    int buttonX = COL_LINE_CENTER_X - (buttonWidth / 2);
-
-    // Draw the colored background button
-    m_tft->fillRoundRect(buttonX, currentY, buttonWidth, DEPARTURES_ROW_HEIGHT, 5, hexToRGB565(dep.routeColor));
-    // Set text properties and draw the line name centered inside the button
-    m_tft->setTextDatum(MC_DATUM);
-    m_tft->setTextColor(hexToRGB565(dep.textColor));
-    m_tft->drawString(lineText.c_str(), COL_LINE_CENTER_X, textY + DEPARTURES_TEXT_Y_OFFSET);
-
-    // --- Column 2: Direction ---
-    std::string directionText = truncateText(dep.direction, maxDirectionWidth);
-
-    // Set text properties and draw the direction, left-aligned to its column
-    m_tft->setTextDatum(ML_DATUM);
-    m_tft->setTextColor(TFT_WHITE); // A standard color for directions
-    m_tft->drawString(directionText.c_str(), COL_DIRECTION_X, textY);
-
-    // --- Column 3: Minutes ---
-    // Set text properties and draw the minutes, right-aligned to its column
-    m_tft->setTextDatum(MR_DATUM);
-    m_tft->setTextColor(hexToRGB565(dep.delayColor));
-    std::string minsText = std::to_string(dep.mins) + " min";
-    if (dep.mins <= 0)
+    RowState next;
+    if (!reachedEnd && i < numToDisplay && m_departures[i].mins < 100) // don't render > 100 mins
     {
-      minsText = "Now";
+      const DisplayDeparture &dep = m_departures[i];
+      next.visible = true;
+      next.line = dep.line;
+      next.routeColor = dep.routeColor;
+      next.textColor = dep.textColor;
+      next.direction = dep.direction;
+      next.minsText = dep.mins <= 0 ? "Now" : std::to_string(dep.mins) + " min";
+      next.delayColor = dep.delayColor;
     }
-    m_tft->drawString(minsText.c_str(), COL_MINS_X, textY);
+    else
+    {
+      reachedEnd = true;
+    }
+
+    size_t bandsBefore = m_dirtyBands.size();
+    drawRow(i, next, maxDirectionWidth, minsCellX);
+    if (m_dirtyBands.size() != bandsBefore)
+      rowsChanged++;
   }
 
-  // Unload the font to free up RAM
-  m_tft->unloadFont();
+  if (fullRepaint)
+  {
+    // the whole region was already marked
+    m_dirtyBands.resize(1);
+    m_paintStats.fullRepaints++;
+  }
+  else if (rowsChanged > 0)
+  {
+    m_paintStats.partialRepaints++;
+  }
+  m_paintStats.totalPixels += m_paintStats.lastPixels;
+
+  recordFrame(frameStart);
 }
 
 /**
- * @brief Truncates text with an ellipsis if it exceeds a max pixel width.
+ * Repaints the cells of one row that differ from what it last drew
  */
-std::string DeparturesDisplayer::truncateText(const std::string &text, int maxWidth)
+void DeparturesDisplayer::drawRow(const int idx, const RowState &next, const int maxDirectionWidth, const int minsCellX)
 {
-  // Return the original text if it already fits
-  if (m_tft->textWidth(text.c_str()) <= maxWidth)
+  RowState &prev = m_rows[idx];
+  bool badgeChanged = prev.visible != next.visible || prev.line != next.line ||
+                      prev.routeColor != next.routeColor || prev.textColor != next.textColor;
+  bool directionChanged = prev.visible != next.visible || prev.direction != next.direction;
+  bool minsChanged = prev.visible != next.visible || prev.minsText != next.minsText ||
+                     prev.delayColor != next.delayColor;
+  if (!badgeChanged && !directionChanged && !minsChanged)
+    return;
+
+  // Calculate the Y position for the top of the current row
+  int currentY = DEPARTURES_START_Y + (idx * (DEPARTURES_ROW_HEIGHT + DEPARTURES_ROW_SPACING));
+  // Calculate the vertical center for text alignment
+  int textY = currentY + DEPARTURES_ROW_HEIGHT / 2 + 2; // +2px for vertical text centering with VLW fonts
+
+  // --- Column 1: Line Name (Constrained Width) ---
+  if (badgeChanged)
   {
-    return text;
+    int badgeCellX = COL_LINE_CENTER_X - DEPARTURES_MAX_LINE_BUTTON_WIDTH / 2;
+    clearCell(badgeCellX, currentY, DEPARTURES_MAX_LINE_BUTTON_WIDTH, DEPARTURES_ROW_HEIGHT);
+    if (next.visible)
+    {
+      // Calculate the ideal width with padding
+      int idealWidth = m_tft->textWidth(next.line.c_str()) + Constants::DISPLAY_ROUTE_PADDING;
+      // Constrain the button width to the maximum allowed
+      int buttonWidth = min(idealWidth, DEPARTURES_MAX_LINE_BUTTON_WIDTH);
+      // Determine the available space for text inside the constrained button
+      int textSpace = buttonWidth - DEPARTURES_MIN_PADDING;
+      // Get the final text, truncated if necessary
+      std::string lineText = truncateText(next.line, textSpace);
+      int buttonX = COL_LINE_CENTER_X - (buttonWidth / 2);
+
+      // Draw the colored background button
+      m_tft->fillRoundRect(buttonX, currentY, buttonWidth, DEPARTURES_ROW_HEIGHT, 5, hexToRGB565(next.routeColor));
+      // Set text properties and draw the line name centered inside the button
+      m_tft->setTextDatum(MC_DATUM);
+      m_tft->setTextColor(hexToRGB565(next.textColor));
+      m_tft->drawString(lineText.c_str(), COL_LINE_CENTER_X, textY + DEPARTURES_TEXT_Y_OFFSET);
+    }
   }
 
-  // Width of the ellipsis is needed for calculations
-  int ellipsisWidth = m_tft->textWidth("...");
-
-  // If even the ellipsis doesn't fit, there's nothing we can do
-  if (ellipsisWidth > maxWidth)
+  // --- Column 2: Direction ---
+  if (directionChanged)
   {
-    return "";
+    clearCell(COL_DIRECTION_X, currentY, maxDirectionWidth, DEPARTURES_ROW_HEIGHT);
+    if (next.visible)
+    {
+      std::string directionText = truncateText(next.direction, maxDirectionWidth);
+
+      // Set text properties and draw the direction, left-aligned to its column
+      m_tft->setTextDatum(ML_DATUM);
+      m_tft->setTextColor(TFT_WHITE); // A standard color for directions
+      m_tft->drawString(directionText.c_str(), COL_DIRECTION_X, textY);
+    }
   }
 
-  // Iterate backwards from the end of the string
-  for (int i = text.length() - 1; i > 0; i--)
+  // --- Column 3: Minutes ---
+  if (minsChanged)
   {
-    std::string sub = text.substr(0, i);
-    if (m_tft->textWidth(sub.c_str()) <= (maxWidth - ellipsisWidth))
+    clearCell(minsCellX, currentY, Constants::DISPLAY_WIDTH - minsCellX, DEPARTURES_ROW_HEIGHT);
+    if (next.visible)
     {
-      return sub + "...";
+      // Set text properties and draw the minutes, right-aligned to its column
+      m_tft->setTextDatum(MR_DATUM);
+      m_tft->setTextColor(hexToRGB565(next.delayColor));
+      m_tft->drawString(next.minsText.c_str(), COL_MINS_X, textY);
     }
   }
 
-  // Fallback for very short max widths
-  return "...";
+  prev = next;
+  m_dirtyBands.push_back({currentY, DEPARTURES_ROW_HEIGHT});
+}
+
+void DeparturesDisplayer::clearCell(const int x, const int y, const int w, const int h)
+{
+  m_tft->fillRect(x, y, w, h, TFT_BLACK);
+  m_paintStats.lastPixels += w * h;
+}
+
+/**
+ * @brief Truncates text with an ellipsis if it exceeds a max pixel width.
+ */
+std::string DeparturesDisplayer::truncateText(const std::string &text, int maxWidth)
+{
+  TextMeasurer *measurer = m_fonts->measurer(m_tft);
+  if (measurer == nullptr)
+    return text;
+  return measurer->truncate(text, maxWidth);
 }
 
 /**
@@ -1,6 +1,7 @@
 #include "frontend/Filter.h"
 
 #include <Arduino.h>
+#include <map>
 #include <set>
 
 namespace
@@ -11,20 +12,47 @@ namespace
   const int LA_METRO_RAPID_COLOR = 0xC54858;
   const int LA_METRO_LOCAL_COLOR = 0xfa7343;
   const int COLOR_WHITE = 0xFFFFFF;
+
+  InternId laMetroId()
+  {
+    static const InternId id = StringInterner::intern(METRO_LOS_ANGELES);
+    return id;
+  }
+
+  InternId bartId()
+  {
+    static const InternId id = StringInterner::intern(BAY_AREA_RAPID_TRANSIT);
+    return id;
+  }
 }
 
 std::vector<DisplayRoute> Filter::modifyRoutes(const std::vector<DisplayRoute> &rts)
 {
   std::vector<DisplayRoute> routes = rts;
 
+  // keep agencies in alphabetical order rather than intern order;
+  // ranks are looked up once so the comparator never takes the interner's lock
+  std::map<InternId, int> agencyRank;
+  {
+    std::map<std::string, InternId> byName;
+    for (const DisplayRoute &r : rts)
+    {
+      byName.emplace(StringInterner::str(r.agencyOnestopId), r.agencyOnestopId);
+    }
+    for (const auto &entry : byName)
+    {
+      agencyRank.emplace(entry.second, agencyRank.size());
+    }
+  }
+
   // first combine directions
-  auto cmp = [](const DisplayRoute &a, const DisplayRoute &b)
+  auto cmp = [&agencyRank](const DisplayRoute &a, const DisplayRoute &b)
   {
     if (a.agencyOnestopId == b.agencyOnestopId)
     {
       return a.name < b.name;
     }
-    return a.agencyOnestopId < b.agencyOnestopId;
+    return agencyRank.at(a.agencyOnestopId) < agencyRank.at(b.agencyOnestopId);
   };
   std::set<DisplayRoute, decltype(cmp)> unique_base_names(cmp);
 
@@ -254,13 +282,13 @@ std::string Filter::truncateRoute(const std::string &routeStr)
   return std::string(result.c_str());
 }
 
-void Filter::modifyAgentSpecific(DisplayDeparture &dep, const std::string &agencyOnestopId)
+void Filter::modifyAgentSpecific(DisplayDeparture &dep, const InternId agencyOnestopId)
 {
-  if (agencyOnestopId == METRO_LOS_ANGELES)
+  if (agencyOnestopId == laMetroId())
   {
     modifyDepLAMetro(dep);
   }
-  else if (agencyOnestopId == BAY_AREA_RAPID_TRANSIT)
+  else if (agencyOnestopId == bartId())
   {
     modifyDepBART(dep);
   }
@@ -272,7 +300,7 @@ void Filter::modifyRoutesLAMetro(std::vector<DisplayRoute> &routes)
   for (int i = 0; i < routes.size(); i++)
   {
     DisplayRoute &route = routes[i];
-    if (route.agencyOnestopId == METRO_LOS_ANGELES)
+    if (route.agencyOnestopId == laMetroId())
     {
       if (route.lineColor == 0 && route.textColor == 0xffffff)
       {
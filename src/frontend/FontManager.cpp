@@ -0,0 +1,206 @@
+#include "frontend/FontManager.h"
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <cstdlib>
+
+FontManager::FontManager(const uint8_t *regularFont, const uint8_t *titleFont)
+    : m_regularFont{regularFont}, m_titleFont{titleFont}, m_stats{} {}
+
+FontManager::~FontManager()
+{
+  for (const ActiveFont &active : m_active)
+  {
+    detach(active.tft);
+  }
+
+  // the metrics were allocated by loadFont, so free them the same way unloadFont would
+  for (CachedFont &cached : m_cache)
+  {
+    free(cached.unicode);
+    free(cached.height);
+    free(cached.width);
+    free(cached.xAdvance);
+    free(cached.dY);
+    free(cached.dX);
+    free(cached.bitmap);
+  }
+}
+
+void FontManager::useRegular(TFT_eSPI *tft)
+{
+  use(tft, m_regularFont);
+}
+
+void FontManager::useTitle(TFT_eSPI *tft)
+{
+  use(tft, m_titleFont);
+}
+
+/**
+ * Makes font the active smooth font on tft, parsing it only the first time
+ */
+void FontManager::use(TFT_eSPI *tft, const uint8_t *font)
+{
+  ActiveFont *active = findActive(tft);
+  if (active != nullptr && active->font == font && tft->fontLoaded)
+  {
+    m_stats.hits++;
+    return;
+  }
+  detach(tft);
+
+  CachedFont *cached = findCached(font);
+  if (cached == nullptr)
+  {
+    // first use: let TFT_eSPI parse it, then keep what it built
+    unsigned long start = micros();
+    tft->loadFont(font);
+    m_stats.loadMicros += micros() - start;
+    m_stats.loads++;
+
+    CachedFont c;
+    c.font = font;
+    c.metrics = tft->gFont;
+    c.unicode = tft->gUnicode;
+    c.height = tft->gHeight;
+    c.width = tft->gWidth;
+    c.xAdvance = tft->gxAdvance;
+    c.dY = tft->gdY;
+    c.dX = tft->gdX;
+    c.bitmap = tft->gBitmap;
+    m_cache.push_back(std::move(c));
+  }
+  else
+  {
+    tft->gFont = cached->metrics;
+    tft->gUnicode = cached->unicode;
+    tft->gHeight = cached->height;
+    tft->gWidth = cached->width;
+    tft->gxAdvance = cached->xAdvance;
+    tft->gdY = cached->dY;
+    tft->gdX = cached->dX;
+    tft->gBitmap = cached->bitmap;
+    tft->fontLoaded = true;
+    m_stats.swaps++;
+  }
+
+  active = findActive(tft);
+  if (active == nullptr)
+  {
+    m_active.push_back({tft, font});
+  }
+  else
+  {
+    active->font = font;
+  }
+}
+
+/**
+ * Detaches any cached font from tft so it never frees the shared metrics
+ */
+void FontManager::release(TFT_eSPI *tft)
+{
+  detach(tft);
+  for (auto it = m_active.begin(); it != m_active.end(); it++)
+  {
+    if (it->tft == tft)
+    {
+      m_active.erase(it);
+      return;
+    }
+  }
+}
+
+/**
+ * Measurer for the font active on tft; nullptr if none was set through use()
+ */
+TextMeasurer *FontManager::measurer(TFT_eSPI *tft)
+{
+  ActiveFont *active = findActive(tft);
+  if (active == nullptr)
+    return nullptr;
+  CachedFont *cached = findCached(active->font);
+  if (cached == nullptr)
+    return nullptr;
+
+  if (!cached->measurer)
+  {
+    cached->measurer.reset(new TextMeasurer(
+        cached->metrics, cached->unicode, cached->xAdvance, cached->dX, cached->width));
+  }
+  return cached->measurer.get();
+}
+
+FontManagerStats FontManager::getStats() const
+{
+  return m_stats;
+}
+
+void FontManager::debugPrintStats() const
+{
+  Serial.println(F("--- Font Manager ---"));
+  Serial.print(F("Fonts cached: "));
+  Serial.println(m_cache.size());
+  Serial.print(F("Loads: "));
+  Serial.println(m_stats.loads);
+  Serial.print(F("Swaps: "));
+  Serial.println(m_stats.swaps);
+  Serial.print(F("Hits: "));
+  Serial.println(m_stats.hits);
+  Serial.print(F("Load time (us): "));
+  Serial.println(m_stats.loadMicros);
+  for (const CachedFont &cached : m_cache)
+  {
+    if (!cached.measurer)
+      continue;
+    TextMeasurerStats tm = cached.measurer->getStats();
+    Serial.print(F("Truncations: "));
+    Serial.print(tm.truncations);
+    Serial.print(F(", memo hits: "));
+    Serial.println(tm.memoHits);
+  }
+}
+
+FontManager::ActiveFont *FontManager::findActive(TFT_eSPI *tft)
+{
+  for (ActiveFont &active : m_active)
+  {
+    if (active.tft == tft)
+      return &active;
+  }
+  return nullptr;
+}
+
+FontManager::CachedFont *FontManager::findCached(const uint8_t *font)
+{
+  for (CachedFont &cached : m_cache)
+  {
+    if (cached.font == font)
+      return &cached;
+  }
+  return nullptr;
+}
+
+void FontManager::detach(TFT_eSPI *tft)
+{
+  if (!tft->fontLoaded)
+    return;
+
+  if (findActive(tft) == nullptr)
+  {
+    // loaded outside the manager, so it owns its own metrics
+    tft->unloadFont();
+    return;
+  }
+
+  tft->gUnicode = nullptr;
+  tft->gHeight = nullptr;
+  tft->gWidth = nullptr;
+  tft->gxAdvance = nullptr;
+  tft->gdY = nullptr;
+  tft->gdX = nullptr;
+  tft->gBitmap = nullptr;
+  tft->fontLoaded = false;
+  tft->unloadFont(); // nothing left to free; just resets the rest of the font state
+}
@@ -0,0 +1,164 @@
+#include "frontend/FrameBuffer.h"
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <esp_heap_caps.h>
+
+#include "Constants.h"
+
+namespace
+{
+  const int FLUSH_BAND_ROWS = 10; // rows per DMA transfer
+  const size_t BOUNCE_BUFFER_BYTES = Constants::DISPLAY_WIDTH * FLUSH_BAND_ROWS * sizeof(uint16_t);
+}
+
+FrameBuffer::FrameBuffer(TFT_eSPI *tft)
+    : m_tft{tft}, m_sprite{tft}, m_bounce{nullptr, nullptr}, m_nextBounce{0},
+      m_active{false}, m_inTransfer{false}, m_stats{} {}
+
+FrameBuffer::~FrameBuffer()
+{
+  finish();
+  release();
+}
+
+/**
+ * Allocates the sprite and bounce buffers; call after tft->begin()
+ */
+bool FrameBuffer::begin()
+{
+  if (m_active)
+    return true;
+
+  if (!psramFound())
+  {
+    Serial.println(F("Frame buffer: no PSRAM, drawing directly"));
+    return false;
+  }
+
+  m_sprite.setColorDepth(16);
+  m_sprite.setAttribute(PSRAM_ENABLE, true);
+  if (m_sprite.createSprite(Constants::DISPLAY_WIDTH, Constants::DISPLAY_HEIGHT) == nullptr)
+  {
+    Serial.println(F("Frame buffer: sprite allocation failed, drawing directly"));
+    return false;
+  }
+
+  for (int i = 0; i < 2; i++)
+  {
+    m_bounce[i] = static_cast<uint16_t *>(heap_caps_malloc(BOUNCE_BUFFER_BYTES, MALLOC_CAP_DMA));
+  }
+  if (m_bounce[0] == nullptr || m_bounce[1] == nullptr || !m_tft->initDMA())
+  {
+    Serial.println(F("Frame buffer: DMA unavailable, drawing directly"));
+    release();
+    return false;
+  }
+
+  m_active = true;
+  return true;
+}
+
+bool FrameBuffer::isActive() const
+{
+  return m_active;
+}
+
+/**
+ * Where to draw: the sprite when active, otherwise the panel itself
+ */
+TFT_eSPI *FrameBuffer::canvas()
+{
+  if (m_active)
+    return &m_sprite;
+  return m_tft;
+}
+
+/**
+ * Queues rows [y, y + h) of the sprite to the panel
+ *
+ * Returns once the last band is queued; call finish() to wait for it.
+ */
+void FrameBuffer::flush(const int y, const int h, const unsigned long composeStartMicros)
+{
+  if (!m_active || h <= 0)
+    return;
+
+  unsigned long start = micros();
+  m_stats.composeMicros += start - composeStartMicros;
+
+  if (!m_inTransfer)
+  {
+    m_tft->startWrite();
+    m_inTransfer = true;
+  }
+
+  // sprite pixels are already stored in panel byte order
+  bool swapBytes = m_tft->getSwapBytes();
+  m_tft->setSwapBytes(false);
+
+  uint16_t *pixels = static_cast<uint16_t *>(m_sprite.getPointer());
+  for (int row = y; row < y + h; row += FLUSH_BAND_ROWS)
+  {
+    int rows = min(FLUSH_BAND_ROWS, y + h - row);
+    m_tft->pushImageDMA(0, row, Constants::DISPLAY_WIDTH, rows,
+                        pixels + row * Constants::DISPLAY_WIDTH, m_bounce[m_nextBounce]);
+    m_nextBounce ^= 1;
+  }
+
+  m_tft->setSwapBytes(swapBytes);
+  m_stats.pixelsPushed += h * Constants::DISPLAY_WIDTH;
+  m_stats.transferMicros += micros() - start;
+}
+
+/**
+ * Waits for queued bands and releases the bus
+ */
+void FrameBuffer::finish()
+{
+  if (!m_inTransfer)
+    return;
+
+  unsigned long start = micros();
+  m_tft->dmaWait();
+  m_tft->endWrite();
+  m_inTransfer = false;
+  m_stats.transferMicros += micros() - start;
+  m_stats.frames++;
+}
+
+FrameBufferStats FrameBuffer::getStats() const
+{
+  return m_stats;
+}
+
+void FrameBuffer::debugPrintStats() const
+{
+  Serial.print(F("Frame buffer: "));
+  if (!m_active)
+  {
+    Serial.println(F("off"));
+    return;
+  }
+  Serial.print(m_stats.frames);
+  Serial.print(F(" flushes, avg compose us: "));
+  Serial.print(m_stats.frames == 0 ? 0 : m_stats.composeMicros / m_stats.frames);
+  Serial.print(F(", avg transfer us: "));
+  Serial.print(m_stats.frames == 0 ? 0 : m_stats.transferMicros / m_stats.frames);
+  Serial.print(F(", pixels: "));
+  Serial.println(m_stats.pixelsPushed);
+}
+
+void FrameBuffer::release()
+{
+  m_active = false;
+  if (m_sprite.created())
+  {
+    m_sprite.deleteSprite();
+  }
+  for (int i = 0; i < 2; i++)
+  {
+    heap_caps_free(m_bounce[i]);
+    m_bounce[i] = nullptr;
+  }
+}
@@ -13,99 +13,187 @@ namespace
   const int ROUTE_PADDING = Constants::DISPLAY_ROUTE_PADDING;
   const int ROUTE_TEXT_Y_OFFSET = 5;
   const int ROUTE_GAP = 6;
+
+  // marquee: pixels moved per frame, frame period, and space before the strip repeats
+  const int MARQUEE_STEP = 2;
+  const int MARQUEE_FRAME_PERIOD = 40; // ms
+  const int MARQUEE_WRAP_GAP = 40;     // px
 }
 
-RouteDisplayer::RouteDisplayer(TFT_eSPI *tft, const uint8_t *fontRegular) : m_tft{tft}, m_curStartPtr{0}, m_fontRegular{fontRegular} {}
+RouteDisplayer::RouteDisplayer(TFT_eSPI *tft, FontManager *fonts)
+    : m_tft{tft}, m_fonts{fonts}, m_marquee{false}, m_stripWidth{0}, m_curPage{0}, m_marqueeOffset{0} {}
 
+/**
+ * Measures every route once and lays out both the pages and the marquee strip
+ */
 void RouteDisplayer::setRoutes(std::vector<DisplayRoute> routes)
 {
-  m_displayRoutes = routes;
-  m_curStartPtr = 0;
+  m_fonts->useRegular(m_tft);
+  TextMeasurer *measurer = m_fonts->measurer(m_tft);
+
+  std::vector<int> textWidths;
+  textWidths.reserve(routes.size());
+  for (const DisplayRoute &route : routes)
+  {
+    textWidths.push_back(measurer != nullptr ? measurer->textWidth(route.name)
+                                             : m_tft->textWidth(route.name.c_str()));
+  }
+
+  layoutPages(routes, textWidths);
+  layoutStrip(routes, textWidths);
+  m_curPage = 0;
+  m_marqueeOffset = 0;
 }
 
 void RouteDisplayer::cycle()
 {
+  unsigned long frameStart = micros();
   m_tft->setTextDatum(MC_DATUM);
-  m_tft->loadFont(m_fontRegular); // Must match the .vlw file name
+  m_fonts->useRegular(m_tft);
 
-  int startPtr = m_curStartPtr;
-  if (startPtr >= m_displayRoutes.size())
-    startPtr = 0;
-  int totalWidth = preCalculation();
-  // int totalWidth = 0;
+  if (m_marquee)
+    cycleMarquee();
+  else
+    cyclePage();
 
-  // =======================================================
-  // 2. DRAWING PASS: Use the total width to center and draw
-  // =======================================================
-  int startX = (Constants::DISPLAY_WIDTH - totalWidth) / 2; // Calculate centered start X
-  int currentX = startX + ROUTE_GAP;
+  recordFrame(frameStart);
+}
 
-  // Clear screen only if we have another page
-  if (!(startPtr == 0 && m_curStartPtr == m_displayRoutes.size()))
-  {
-    m_tft->fillRect(0, ROUTE_START_Y, Constants::DISPLAY_WIDTH, ROUTE_BUTTON_HEIGHT, TFT_BLACK);
-  }
+void RouteDisplayer::setMarquee(const bool marquee)
+{
+  m_marquee = marquee;
+}
+
+bool RouteDisplayer::isMarquee() const
+{
+  return m_marquee;
+}
+
+/**
+ * How often cycle() should run; pages flip every pagePeriodMs
+ */
+int RouteDisplayer::getFramePeriod(const int pagePeriodMs) const
+{
+  return m_marquee ? MARQUEE_FRAME_PERIOD : pagePeriodMs;
+}
+
+int RouteDisplayer::getRegionY()
+{
+  return ROUTE_START_Y;
+}
+
+int RouteDisplayer::getRegionHeight()
+{
+  return ROUTE_BUTTON_HEIGHT;
+}
+
+/**
+ * Breaks routes into centered pages that fit the screen, one agency per page
+ */
+void RouteDisplayer::layoutPages(const std::vector<DisplayRoute> &routes, const std::vector<int> &textWidths)
+{
+  m_pages.clear();
 
-  for (int i = startPtr; i < m_curStartPtr; i++)
+  int start = 0;
+  while (start < routes.size())
   {
-    int textW = m_tft->textWidth(m_displayRoutes[i].name.c_str());
-    int buttonWidth = textW + ROUTE_PADDING;
+    // 1. measure how many routes fit on this page
+    int totalWidth = ROUTE_GAP;
+    int end = start;
+    while (end < routes.size())
+    {
+      if (totalWidth + textWidths[end] + ROUTE_PADDING + ROUTE_GAP > Constants::DISPLAY_WIDTH ||
+          routes[end].agencyOnestopId != routes[start].agencyOnestopId)
+      {
+        // cut off if doesn't fit on screen or the agency ID doesn't match
+        break;
+      }
+      totalWidth += textWidths[end] + ROUTE_PADDING + ROUTE_GAP;
+      end++;
+    }
 
-    uint16_t lineColor = hexToRGB565(m_displayRoutes[i].lineColor);
-    uint16_t textColor = hexToRGB565(m_displayRoutes[i].textColor);
+    // one route too long for the screen gets a page of its own
+    if (end == start)
+    {
+      totalWidth = textWidths[start];
+      end = start + 1;
+    }
 
-    m_tft->fillRoundRect(currentX, ROUTE_START_Y, buttonWidth, ROUTE_BUTTON_HEIGHT, 4, lineColor);
-    m_tft->setTextColor(textColor);
-    m_tft->drawString(m_displayRoutes[i].name.c_str(), currentX + buttonWidth / 2, ROUTE_START_Y + ROUTE_BUTTON_HEIGHT / 2 + ROUTE_TEXT_Y_OFFSET);
+    // 2. center the page
+    std::vector<RouteBadge> page;
+    int currentX = (Constants::DISPLAY_WIDTH - totalWidth) / 2 + ROUTE_GAP;
+    for (int i = start; i < end; i++)
+    {
+      int buttonWidth = textWidths[i] + ROUTE_PADDING;
+      page.push_back({currentX, buttonWidth, routes[i].name,
+                      hexToRGB565(routes[i].lineColor), hexToRGB565(routes[i].textColor)});
+      currentX += buttonWidth + ROUTE_GAP;
+    }
+    m_pages.push_back(std::move(page));
+    start = end;
+  }
+}
+
+/**
+ * One continuous row of every route for the marquee
+ */
+void RouteDisplayer::layoutStrip(const std::vector<DisplayRoute> &routes, const std::vector<int> &textWidths)
+{
+  m_strip.clear();
 
+  int currentX = 0;
+  for (int i = 0; i < routes.size(); i++)
+  {
+    int buttonWidth = textWidths[i] + ROUTE_PADDING;
+    m_strip.push_back({currentX, buttonWidth, routes[i].name,
+                       hexToRGB565(routes[i].lineColor), hexToRGB565(routes[i].textColor)});
     currentX += buttonWidth + ROUTE_GAP;
   }
-  m_tft->unloadFont();
+  m_stripWidth = currentX + MARQUEE_WRAP_GAP;
+}
+
+void RouteDisplayer::drawBadge(const RouteBadge &badge, const int x)
+{
+  m_tft->fillRoundRect(x, ROUTE_START_Y, badge.width, ROUTE_BUTTON_HEIGHT, 4, badge.lineColor);
+  m_tft->setTextColor(badge.textColor);
+  m_tft->drawString(badge.name.c_str(), x + badge.width / 2, ROUTE_START_Y + ROUTE_BUTTON_HEIGHT / 2 + ROUTE_TEXT_Y_OFFSET);
 }
 
-// returns total width
-int RouteDisplayer::preCalculation()
+void RouteDisplayer::cyclePage()
 {
-  // =======================================================
-  // 1. PRE-CALCULATION PASS: Measure the total width first
-  // =======================================================
-  if (m_displayRoutes.size() == 0)
-    return 0;
+  if (m_pages.empty())
+    return;
+  if (m_curPage >= m_pages.size())
+    m_curPage = 0;
 
-  if (m_curStartPtr >= m_displayRoutes.size())
+  // Clear screen only if we have another page
+  if (m_pages.size() > 1)
   {
-    m_curStartPtr = 0;
+    m_tft->fillRect(0, ROUTE_START_Y, Constants::DISPLAY_WIDTH, ROUTE_BUTTON_HEIGHT, TFT_BLACK);
   }
 
-  int totalWidth = ROUTE_GAP;
-  std::string curAgency = m_displayRoutes[m_curStartPtr].agencyOnestopId;
-  int prevStartPtr = m_curStartPtr;
-  m_curStartPtr = m_displayRoutes.size();
-  for (int i = prevStartPtr; i < m_displayRoutes.size(); i++)
+  for (const RouteBadge &badge : m_pages[m_curPage])
   {
-    int textW = m_tft->textWidth(m_displayRoutes[i].name.c_str());
-    if (totalWidth + textW + ROUTE_PADDING + ROUTE_GAP > Constants::DISPLAY_WIDTH || m_displayRoutes[i].agencyOnestopId != curAgency)
-    {
-      // cut off if doesn't fit on screen or the agency ID doesn't match
-      m_curStartPtr = i;
-      break;
-    }
-
-    totalWidth += textW + ROUTE_PADDING; // Add button width
-    // Serial.print("text w: ");
-    // Serial.println(tft.textWidth(m_displayRoutes[i].name));
-    totalWidth += ROUTE_GAP;
+    drawBadge(badge, badge.x);
   }
+  m_curPage++;
+}
 
-  // if one long ass route don't render it
-  if (m_curStartPtr == prevStartPtr && m_curStartPtr < m_displayRoutes.size())
+void RouteDisplayer::cycleMarquee()
+{
+  m_tft->fillRect(0, ROUTE_START_Y, Constants::DISPLAY_WIDTH, ROUTE_BUTTON_HEIGHT, TFT_BLACK);
+  if (m_strip.empty())
+    return;
+
+  // draw each badge where it lands on screen, plus its copy one strip later for the wrap
+  for (const RouteBadge &badge : m_strip)
   {
-    m_curStartPtr++;
-    return m_tft->textWidth(m_displayRoutes[prevStartPtr].name.c_str());
+    for (int x = badge.x - m_marqueeOffset; x < Constants::DISPLAY_WIDTH; x += m_stripWidth)
+    {
+      if (x + badge.width > 0)
+        drawBadge(badge, x);
+    }
   }
 
-  // Serial.print("start ptr: ");
-  // Serial.println(m_curStartPtr);
-
-  return totalWidth;
-}
\ No newline at end of file
+  m_marqueeOffset = (m_marqueeOffset + MARQUEE_STEP) % m_stripWidth;
+}
@@ -0,0 +1,202 @@
+#include "frontend/TextMeasurer.h"
+
+#include <Arduino.h>
+#include <string>
+
+namespace
+{
+  const char *ELLIPSIS = "...";
+  const size_t MEMO_MAX_ENTRIES = 64;
+
+  // same decoding as TFT_eSPI::decodeUTF8; advances idx past the sequence
+  uint16_t decodeUTF8(const std::string &text, size_t &idx)
+  {
+    uint8_t c = text[idx];
+    size_t remaining = text.size() - idx;
+    if ((c & 0x80) == 0x00)
+    {
+      idx += 1;
+      return c;
+    }
+    if ((c & 0xE0) == 0xC0 && remaining > 1)
+    {
+      uint16_t code = ((c & 0x1F) << 6) | (text[idx + 1] & 0x3F);
+      idx += 2;
+      return code;
+    }
+    if ((c & 0xF0) == 0xE0 && remaining > 2)
+    {
+      uint16_t code = ((c & 0x0F) << 12) | ((text[idx + 1] & 0x3F) << 6) | (text[idx + 2] & 0x3F);
+      idx += 3;
+      return code;
+    }
+    idx += 1;
+    return c;
+  }
+}
+
+TextMeasurer::TextMeasurer(const TFT_eSPI::fontMetrics &metrics,
+                           const uint16_t *unicode,
+                           const uint8_t *xAdvance,
+                           const int8_t *dX,
+                           const uint8_t *width)
+    : m_spaceWidth{metrics.spaceWidth}, m_leadAdjust{0}, m_stats{}
+{
+  for (Glyph &g : m_ascii)
+  {
+    g = {false, 0, 0, 0};
+  }
+
+  for (int i = 0; i < metrics.gCount; i++)
+  {
+    Glyph g = {true, xAdvance[i], dX[i], width[i]};
+    if (unicode[i] >= ASCII_FIRST && unicode[i] <= ASCII_LAST)
+      m_ascii[unicode[i] - ASCII_FIRST] = g;
+    else
+      m_extended[unicode[i]] = g;
+  }
+
+  m_ellipsisWidth = textWidth(ELLIPSIS);
+}
+
+int TextMeasurer::textWidth(const std::string &text)
+{
+  layout(text);
+  return prefixWidth(m_bytes.size() - 1);
+}
+
+/**
+ * Number of bytes of the longest prefix of text that fits in maxWidth
+ *
+ * Always ends on a character boundary.
+ */
+size_t TextMeasurer::fitPrefix(const std::string &text, const int maxWidth)
+{
+  layout(text);
+  return m_bytes[fitChars(m_bytes.size() - 1, maxWidth)];
+}
+
+/**
+ * Cuts text to fit in maxWidth, ending it with "..." if it had to be cut
+ *
+ * The cut point is binary searched over the prefix widths. Results are
+ * memoized per (text, maxWidth).
+ */
+std::string TextMeasurer::truncate(const std::string &text, const int maxWidth)
+{
+  m_stats.truncations++;
+  std::string key = text;
+  key.push_back('\0');
+  key += std::to_string(maxWidth);
+  auto it = m_memo.find(key);
+  if (it != m_memo.end())
+  {
+    m_stats.memoHits++;
+    return it->second;
+  }
+
+  std::string res;
+  layout(text);
+  size_t numChars = m_bytes.size() - 1;
+  if (prefixWidth(numChars) <= maxWidth)
+  {
+    // Return the original text if it already fits
+    res = text;
+  }
+  else if (m_ellipsisWidth <= maxWidth && numChars > 1)
+  {
+    // keep at least one character, and always drop at least one
+    size_t fit = fitChars(numChars - 1, maxWidth - m_ellipsisWidth);
+    if (fit >= 1)
+      res = text.substr(0, m_bytes[fit]) + ELLIPSIS;
+    else
+      res = ELLIPSIS; // Fallback for very short max widths
+  }
+  else if (m_ellipsisWidth <= maxWidth)
+  {
+    res = ELLIPSIS;
+  }
+  // else even the ellipsis doesn't fit
+
+  if (m_memo.size() >= MEMO_MAX_ENTRIES)
+    m_memo.clear();
+  m_memo.emplace(std::move(key), res);
+  return res;
+}
+
+TextMeasurerStats TextMeasurer::getStats() const
+{
+  return m_stats;
+}
+
+TextMeasurer::Glyph TextMeasurer::lookup(const uint16_t code) const
+{
+  if (code >= ASCII_FIRST && code <= ASCII_LAST)
+    return m_ascii[code - ASCII_FIRST];
+
+  auto it = m_extended.find(code);
+  if (it == m_extended.end())
+    return {false, 0, 0, 0};
+  return it->second;
+}
+
+/**
+ * Fills the prefix sums and character offsets for text
+ */
+void TextMeasurer::layout(const std::string &text)
+{
+  m_prefix.assign(1, 0);
+  m_tail.clear();
+  m_bytes.assign(1, 0);
+  m_leadAdjust = 0;
+
+  size_t idx = 0;
+  while (idx < text.size())
+  {
+    Glyph g = lookup(decodeUTF8(text, idx));
+    if (g.found)
+    {
+      // a glyph hanging left of the first origin widens the string
+      if (m_prefix.size() == 1 && g.dX < 0)
+        m_leadAdjust = -g.dX;
+      m_prefix.push_back(m_prefix.back() + g.advance);
+      m_tail.push_back(g.dX + g.width);
+    }
+    else
+    {
+      // TFT_eSPI draws missing glyphs as a space
+      m_prefix.push_back(m_prefix.back() + m_spaceWidth + 1);
+      m_tail.push_back(m_spaceWidth + 1);
+    }
+    m_bytes.push_back(idx);
+  }
+}
+
+/**
+ * Width of the first numChars characters of the last layout
+ *
+ * Like TFT_eSPI, the last character counts its drawn width, not its advance.
+ */
+int TextMeasurer::prefixWidth(const size_t numChars) const
+{
+  if (numChars == 0)
+    return 0;
+  return m_leadAdjust + m_prefix[numChars - 1] + m_tail[numChars - 1];
+}
+
+/**
+ * Most characters, up to maxChars, whose prefix fits in maxWidth
+ */
+size_t TextMeasurer::fitChars(const size_t maxChars, const int maxWidth) const
+{
+  size_t lo = 0, hi = maxChars;
+  while (lo < hi)
+  {
+    size_t mid = (lo + hi + 1) / 2;
+    if (prefixWidth(mid) <= maxWidth)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
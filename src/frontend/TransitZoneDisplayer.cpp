@@ -15,20 +15,21 @@ namespace
 
 TransitZoneDisplayer::TransitZoneDisplayer(const std::string &name,
                                            TFT_eSPI *tft,
-                                           const uint8_t *fontRegular,
-                                           const uint8_t *fontLarge,
+                                           FrameBuffer *frameBuffer,
+                                           FontManager *fonts,
                                            int routeRefreshPeriod,
                                            int departuresRefreshPeriod)
     : m_name{name},
       m_tft{tft},
-      m_fontRegular{fontRegular},
-      m_fontLarge{fontLarge},
+      m_frameBuffer{frameBuffer},
+      m_canvas{frameBuffer->canvas()},
+      m_fonts{fonts},
       m_routeRefreshPeriod{routeRefreshPeriod},
       m_departuresRefreshPeriod{departuresRefreshPeriod},
       m_lastRouteRefresh{0},
       m_lastDeparturesRefresh{0},
-      m_routeDisplay{tft, fontRegular},
-      m_departuresDisplay{tft, fontRegular}
+      m_routeDisplay{m_canvas, fonts},
+      m_departuresDisplay{m_canvas, fonts}
 {
 }
 
@@ -37,28 +38,40 @@ void TransitZoneDisplayer::setRoutes(const std::vector<DisplayRoute> &displayRou
   m_routeDisplay.setRoutes(displayRoutes);
 }
 
+/**
+ * Scroll the route bar continuously instead of flipping pages
+ */
+void TransitZoneDisplayer::setRouteMarquee(const bool marquee)
+{
+  m_routeDisplay.setMarquee(marquee);
+}
+
 void TransitZoneDisplayer::setDepartures(const std::vector<DisplayDeparture> &displayDeps)
 {
   m_departuresDisplay.setDepartures(displayDeps);
 }
 
+void TransitZoneDisplayer::setDepartures(std::vector<DisplayDeparture> &&displayDeps)
+{
+  m_departuresDisplay.setDepartures(std::move(displayDeps));
+}
+
 void TransitZoneDisplayer::drawInitializing()
 {
   m_tft->fillScreen(TFT_BLACK);
-  m_tft->loadFont(m_fontRegular); // Must match the .vlw file name
+  m_fonts->useRegular(m_tft);
   m_tft->setTextColor(TFT_WHITE);
   m_tft->setTextDatum(MC_DATUM);
   m_tft->drawString("Initializing...",
                     Constants::DISPLAY_WIDTH / 2,
                     Constants::DISPLAY_HEIGHT / 2);
-  m_tft->unloadFont();
 }
 
 void TransitZoneDisplayer::drawAreYouSure()
 {
   // draw the "are you sure?"
   m_tft->fillScreen(TFT_BLACK);
-  m_tft->loadFont(m_fontRegular); // Must match the .vlw file name
+  m_fonts->useRegular(m_tft);
   m_tft->setTextSize(12);
   m_tft->setTextColor(TFT_WHITE);
   m_tft->setTextDatum(MC_DATUM);
@@ -84,49 +97,92 @@ void TransitZoneDisplayer::drawAreYouSure()
   m_tft->drawString("2 - No",
                     Constants::DISPLAY_WIDTH / 2 + NEXT_INSTRUCTION_X_OFFSET,
                     SELECT_INSTRUCTION_Y);
-  m_tft->unloadFont();
 }
 
 void TransitZoneDisplayer::cycle()
 {
+  unsigned long composeStart = micros();
   drawTitle();
 
   // capture timestamp of BEGINNING of cycle
   m_lastRouteRefresh = millis();
   m_routeDisplay.cycle();
 
+  // the title cleared the whole screen
   m_lastDeparturesRefresh = millis();
+  m_departuresDisplay.invalidate();
   m_departuresDisplay.cycle();
+
+  // the whole screen, since whatever was drawn directly before is still showing
+  m_frameBuffer->flush(0, Constants::DISPLAY_HEIGHT, composeStart);
+  m_frameBuffer->finish();
 }
 
 void TransitZoneDisplayer::loop()
 {
   // check route display; BEGINNING of cycle
   std::time_t curTime = millis();
-  if (curTime - m_lastRouteRefresh >= m_routeRefreshPeriod)
+  if (curTime - m_lastRouteRefresh >= m_routeDisplay.getFramePeriod(m_routeRefreshPeriod))
   {
+    unsigned long composeStart = micros();
     m_routeDisplay.cycle();
+    m_frameBuffer->flush(RouteDisplayer::getRegionY(), RouteDisplayer::getRegionHeight(), composeStart);
     m_lastRouteRefresh = curTime;
   }
 
   // check departure display; BEGINNING of cycle
+  // composed while the route bar is still being sent
   curTime = millis();
   if (curTime - m_lastDeparturesRefresh >= m_departuresRefreshPeriod)
   {
+    unsigned long composeStart = micros();
     m_departuresDisplay.cycle();
+    for (const DirtyBand &band : m_departuresDisplay.getDirtyBands())
+    {
+      m_frameBuffer->flush(band.y, band.h, composeStart);
+      composeStart = micros(); // only count composition once
+    }
     m_lastDeparturesRefresh = curTime;
   }
+
+  m_frameBuffer->finish();
+}
+
+/**
+ * Time until loop() has something to draw; 0 if it is already due
+ */
+unsigned long TransitZoneDisplayer::msUntilNextFrame() const
+{
+  unsigned long now = millis();
+  unsigned long routeDue = m_lastRouteRefresh + m_routeDisplay.getFramePeriod(m_routeRefreshPeriod);
+  unsigned long departuresDue = m_lastDeparturesRefresh + m_departuresRefreshPeriod;
+  unsigned long nextDue = min(routeDue, departuresDue);
+  if (static_cast<long>(nextDue - now) <= 0)
+    return 0;
+  return nextDue - now;
+}
+
+void TransitZoneDisplayer::debugPrintFrameStats() const
+{
+  Serial.println(F("--- Frame Stats ---"));
+  BaseDisplayer::debugPrintFrameStats("Title");
+  m_routeDisplay.debugPrintFrameStats("Routes");
+  m_departuresDisplay.debugPrintFrameStats("Departures");
+  m_departuresDisplay.debugPrintPaintStats();
+  m_frameBuffer->debugPrintStats();
 }
 
 void TransitZoneDisplayer::drawTitle()
 {
+  unsigned long frameStart = micros();
+
   // clear screen and set title
-  m_tft->fillScreen(TFT_BLACK);
-  m_tft->loadFont(m_fontLarge); // Must match the .vlw file name
-  m_tft->setTextSize(16);
-  m_tft->setTextColor(TFT_WHITE, TFT_BLACK);
-  m_tft->setTextDatum(TC_DATUM);
-  m_tft->setTextWrap(false);
-  m_tft->drawString(m_name.c_str(), NAME_X, NAME_Y);
-  m_tft->unloadFont();
+  m_canvas->fillScreen(TFT_BLACK);
+  m_fonts->useTitle(m_canvas);
+  m_canvas->setTextSize(16);
+  m_canvas->setTextColor(TFT_WHITE, TFT_BLACK);
+  m_canvas->setTextDatum(TC_DATUM);
+  m_canvas->setTextWrap(false);
+  m_canvas->drawString(m_name.c_str(), NAME_X, NAME_Y);
+  recordFrame(frameStart);
 }
\ No newline at end of file
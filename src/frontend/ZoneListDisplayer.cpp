@@ -21,51 +21,46 @@ namespace
   const int FILTER_CURSOR_Y = 110;
 }
 
-ZoneListDisplayer::ZoneListDisplayer(TFT_eSPI *tft,
-                                     const uint8_t *fontRegular,
-                                     const uint8_t *fontLarge) : m_tft{tft}, m_fontRegular{fontRegular}, m_fontLarge{fontLarge}
+ZoneListDisplayer::ZoneListDisplayer(TFT_eSPI *tft, FontManager *fonts) : m_tft{tft}, m_fonts{fonts}
 {
 }
 
 void ZoneListDisplayer::drawConnecting()
 {
   m_tft->fillScreen(TFT_BLACK);
-  m_tft->loadFont(m_fontRegular); // Must match the .vlw file name
+  m_fonts->useRegular(m_tft);
   m_tft->setTextSize(12);
   m_tft->setTextColor(TFT_WHITE);
   m_tft->setTextDatum(MC_DATUM);
   m_tft->drawString("Connecting to WiFi...", Constants::DISPLAY_WIDTH / 2, Constants::DISPLAY_HEIGHT / 2);
-  m_tft->unloadFont();
 }
 
 void ZoneListDisplayer::drawNoZonesFound()
 {
   m_tft->fillScreen(TFT_BLACK);
-  m_tft->loadFont(m_fontRegular); // Must match the .vlw file name
+  m_fonts->useRegular(m_tft);
   m_tft->setTextSize(12);
   m_tft->setTextColor(TFT_WHITE);
   m_tft->setTextDatum(MC_DATUM);
   m_tft->drawString("No zones found", Constants::DISPLAY_WIDTH / 2, Constants::DISPLAY_HEIGHT / 2);
-  m_tft->unloadFont();
 }
 
 void ZoneListDisplayer::drawZone(TransitZone *zone, TransitZone *next, const Whitelist &wl)
 {
   // draw the title
   m_tft->fillScreen(TFT_BLACK);
-  m_tft->loadFont(m_fontLarge); // Must match the .vlw file name
+  m_fonts->useTitle(m_tft);
   m_tft->setTextSize(16);
   m_tft->setTextColor(TFT_WHITE);
   m_tft->setTextDatum(TC_DATUM);
   m_tft->setTextWrap(false);
   m_tft->drawString(zone->getName().c_str(), Constants::DISPLAY_WIDTH / 2, NAME_Y);
-  m_tft->unloadFont();
 
   // draw the coordinates
   String latStr(zone->getLat(), COORD_DIGITS);
   String lonStr(zone->getLon(), COORD_DIGITS);
   String radStr(zone->getRadius(), RAD_DIGITS);
-  m_tft->loadFont(m_fontRegular); // Must match the .vlw file name
+  m_fonts->useRegular(m_tft);
   m_tft->setTextSize(12);
   m_tft->setTextColor(TFT_DARKGREY);
   m_tft->drawString(latStr + ", " + lonStr, Constants::DISPLAY_WIDTH / 2, COORDS_Y);
@@ -119,10 +114,12 @@ void ZoneListDisplayer::drawZone(TransitZone *zone, TransitZone *next, const Whi
       int maxNameWidth = Constants::DISPLAY_WIDTH - startX - m_tft->textWidth(prefix) - m_tft->textWidth(ellipsisSuffix);
 
       // Shorten the zone name until it fits within the maxNameWidth
-      String truncatedName = zoneName;
-      while (m_tft->textWidth(truncatedName) > maxNameWidth && truncatedName.length() > 0)
+      std::string name = next->getName();
+      TextMeasurer *measurer = m_fonts->measurer(m_tft);
+      String truncatedName = "";
+      if (measurer != nullptr && maxNameWidth > 0)
       {
-        truncatedName.remove(truncatedName.length() - 1); // Remove the last character
+        truncatedName = name.substr(0, measurer->fitPrefix(name, maxNameWidth)).c_str();
       }
 
       // 3. Construct and draw the final, truncated string
@@ -137,5 +134,4 @@ void ZoneListDisplayer::drawZone(TransitZone *zone, TransitZone *next, const Whi
     m_tft->drawString("1 - Start", Constants::DISPLAY_WIDTH / 2, SELECT_INSTRUCTION_Y);
   }
 
-  m_tft->unloadFont();
 }
\ No newline at end of file
@@ -6,6 +6,19 @@
 #include "Constants.h"
 #include "ZoneManager.h"
 #include "ButtonReader.h"
+#include "backend/RequestScheduler.h"
+#include "backend/ZoneCache.h"
+#include "backend/ZoneWarmer.h"
+#include "types/StringInterner.h"
+#include "types/TaskStats.h"
+
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <hal/gpio_ll.h>
+#include <soc/gpio_struct.h>
+#endif
 
 enum class State
 {
@@ -22,12 +35,22 @@ ZoneListDisplayer *displayer;
 TFT_eSPI *tft;
 TimeRetriever *timeRetriever;
 Whitelist whitelist;
+ZoneWarmer *zoneWarmer;
 
 ButtonReader reader1(Constants::BUTTON_1_PIN);
 ButtonReader reader2(Constants::BUTTON_2_PIN);
 
 std::vector<TransitZone *> zones;
 
+std::string serialCmd;
+const int SERIAL_CMD_MAX_LEN = 32;
+
+// the loop sleeps until a button edge or the display needs it
+TaskHandle_t loopTaskHandle = NULL;
+TaskStats loopStats;
+const unsigned long BUTTON_POLL_MS = 10;     // while a press is debouncing
+const unsigned long MAX_LOOP_SLEEP_MS = 500; // still picks up serial commands
+
 void configurePins()
 {
   pinMode(Constants::ROUTE_ERROR_PIN, OUTPUT);
@@ -44,6 +67,89 @@ void configurePins()
   digitalWrite(Constants::RATE_LIMIT_PIN, LOW);
 }
 
+#if CONFIG_PM_ENABLE
+/**
+ * Light sleep only wakes on a level, and the wakeup shares the pin's
+ * interrupt type; a low-level interrupt would fire for as long as a button
+ * is held. So the level is armed only while the loop idles with both
+ * buttons up, and the first press or the next wake puts the edges back.
+ */
+void armButtonWakeups()
+{
+  if (digitalRead(Constants::BUTTON_1_PIN) == LOW || digitalRead(Constants::BUTTON_2_PIN) == LOW)
+    return;
+
+  gpio_wakeup_enable(static_cast<gpio_num_t>(Constants::BUTTON_1_PIN), GPIO_INTR_LOW_LEVEL);
+  gpio_wakeup_enable(static_cast<gpio_num_t>(Constants::BUTTON_2_PIN), GPIO_INTR_LOW_LEVEL);
+}
+
+// register writes only, so it is safe in the ISR
+void IRAM_ATTR restoreButtonEdges()
+{
+  gpio_ll_wakeup_disable(&GPIO, Constants::BUTTON_1_PIN);
+  gpio_ll_wakeup_disable(&GPIO, Constants::BUTTON_2_PIN);
+  gpio_ll_set_intr_type(&GPIO, Constants::BUTTON_1_PIN, GPIO_INTR_ANYEDGE);
+  gpio_ll_set_intr_type(&GPIO, Constants::BUTTON_2_PIN, GPIO_INTR_ANYEDGE);
+}
+#endif
+
+void IRAM_ATTR onButtonEdge()
+{
+#if CONFIG_PM_ENABLE
+  restoreButtonEdges();
+#endif
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(loopTaskHandle, &woken);
+  if (woken)
+    portYIELD_FROM_ISR();
+}
+
+void configureWakeups()
+{
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
+  attachInterrupt(digitalPinToInterrupt(Constants::BUTTON_1_PIN), onButtonEdge, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(Constants::BUTTON_2_PIN), onButtonEdge, CHANGE);
+
+#if CONFIG_PM_ENABLE
+  // edge interrupts don't wake the chip from light sleep; see armButtonWakeups()
+  esp_sleep_enable_gpio_wakeup();
+
+  // let the chip light sleep whenever both cores are idle
+  esp_pm_config_esp32_t pmConfig = {};
+  pmConfig.max_freq_mhz = 240;
+  pmConfig.min_freq_mhz = 80;
+  pmConfig.light_sleep_enable = true;
+  if (esp_pm_configure(&pmConfig) != ESP_OK)
+    Serial.println(F("Automatic light sleep unavailable"));
+#endif
+}
+
+void waitForNextEvent()
+{
+  unsigned long waitMs = MAX_LOOP_SLEEP_MS;
+  if (reader1.isSettling() || reader2.isSettling())
+  {
+    waitMs = BUTTON_POLL_MS;
+  }
+  else if (state == State::TRANSIT)
+  {
+    waitMs = min(waitMs, zoneManager->msUntilNextFrame());
+  }
+
+  loopStats.beginWait();
+#if CONFIG_PM_ENABLE
+  if (waitMs > BUTTON_POLL_MS)
+  {
+    armButtonWakeups();
+  }
+#endif
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+#if CONFIG_PM_ENABLE
+  restoreButtonEdges();
+#endif
+  loopStats.endWait();
+}
+
 void connectToWifi()
 {
   Serial.print("Attempting to connect to SSID: ");
@@ -61,6 +167,101 @@ void connectToWifi()
   Serial.println(config.getSSID().c_str());
 }
 
+void runSerialCommand(const std::string &cmd)
+{
+  if (cmd == "interner")
+  {
+    StringInterner::debugPrintStats();
+  }
+  else if (cmd == "fonts")
+  {
+    config.getFontManager()->debugPrintStats();
+  }
+  else if (cmd == "frames")
+  {
+    if (state == State::SELECT)
+      Serial.println(F("No zone running"));
+    else
+      zoneManager->debugPrintDisplayStats();
+  }
+  else if (cmd == "power")
+  {
+    loopStats.debugPrint("Main loop");
+    if (state != State::SELECT)
+      zoneManager->debugPrintTaskStats();
+  }
+  else if (cmd == "refresh")
+  {
+    if (state != State::SELECT)
+      zoneManager->requestRefresh();
+  }
+  else if (cmd == "zones")
+  {
+    if (state == State::SELECT)
+      Serial.println(F("No zone running"));
+    else
+      zoneManager->debugPrintZoneStats();
+  }
+  else if (cmd == "requests")
+  {
+    RequestScheduler::debugPrintStats();
+    config.getCaller()->debugPrintStats();
+    config.getAsyncCaller()->debugPrintStats();
+  }
+  else if (cmd == "heap")
+  {
+    Serial.print(F("Free heap: "));
+    Serial.println(ESP.getFreeHeap());
+  }
+  else if (!cmd.empty())
+  {
+    Serial.println(F("Commands: interner, fonts, frames, power, refresh, zones, requests, heap"));
+  }
+}
+
+/**
+ * Reads diagnostic commands from serial, one per line
+ */
+void readSerialCommands()
+{
+  while (Serial.available() > 0)
+  {
+    char c = Serial.read();
+    if (c == '\n' || c == '\r')
+    {
+      runSerialCommand(serialCmd);
+      serialCmd.clear();
+    }
+    else if (serialCmd.size() < SERIAL_CMD_MAX_LEN)
+    {
+      serialCmd += c;
+    }
+  }
+}
+
+int getNextZoneIdx()
+{
+  int nextZoneIdx = zoneIdx + 1;
+  if (nextZoneIdx >= zones.size())
+    nextZoneIdx = 0;
+  return nextZoneIdx;
+}
+
+/**
+ * Warms the highlighted zone, then the one shown as next
+ */
+void warmSelectedZones()
+{
+  if (zones.empty())
+    return;
+
+  std::vector<TransitZone *> toWarm{zones[zoneIdx]};
+  int nextZoneIdx = getNextZoneIdx();
+  if (nextZoneIdx != zoneIdx)
+    toWarm.push_back(zones[nextZoneIdx]);
+  zoneWarmer->warm(toWarm);
+}
+
 void setup()
 {
   // put your setup code here, to run once:
@@ -73,13 +274,19 @@ void setup()
   tft = config.getTFT();
   timeRetriever = config.getTimeRetriever();
   whitelist = config.getWhitelist();
+  zoneWarmer = new ZoneWarmer(whitelist);
 
   // configure pins
   configurePins();
+  configureWakeups();
+
+  // mount flash for cached routes and stops
+  ZoneCache::begin();
 
   // configure tft
   tft->begin();
   tft->setRotation(1); // Depending on the use-case.
+  config.getFrameBuffer()->begin();
 
   // connect to wifi
   displayer->drawConnecting();
@@ -95,6 +302,20 @@ void setup()
     return;
   }
 
+  zoneWarmer->begin();
+
+  // lobby displays skip the selection screen and rotate between every zone
+  if (config.isLobbyMode() && !zones.empty())
+  {
+    zoneManager = new ZoneManager(zones, tft, timeRetriever, whitelist, config.getFrameBuffer(), config.getFontManager());
+    state = State::TRANSIT;
+    zoneManager->init();
+    return;
+  }
+
+  // start fetching the highlighted zones while the user decides
+  warmSelectedZones();
+
   // draw screen
   if (zones.empty())
   {
@@ -112,17 +333,19 @@ void setup()
 
 void drawSelectScreen()
 {
-  int nextZoneIdx = zoneIdx + 1;
-  if (nextZoneIdx >= zones.size())
-    nextZoneIdx = 0;
-  displayer->drawZone(zones[zoneIdx], zones[nextZoneIdx], whitelist);
+  displayer->drawZone(zones[zoneIdx], zones[getNextZoneIdx()], whitelist);
 }
 
 void loop()
 {
   // put your main code here, to run repeatedly:
+  readSerialCommands();
+
   if (zones.empty())
+  {
+    waitForNextEvent();
     return;
+  }
 
   bool button1Res = reader1.readButton();
   bool button2Res = reader2.readButton();
@@ -137,7 +360,9 @@ void loop()
     digitalWrite(Constants::RATE_LIMIT_PIN, LOW);
     if (button1Res)
     {
-      zoneManager = new ZoneManager(zones[zoneIdx], tft, timeRetriever, whitelist, config.getRegularFont(), config.getTitleFont());
+      // the zone manager's task takes over the API
+      zoneWarmer->stop();
+      zoneManager = new ZoneManager({zones[zoneIdx]}, tft, timeRetriever, whitelist, config.getFrameBuffer(), config.getFontManager());
       state = State::TRANSIT;
       zoneManager->init();
     }
@@ -147,6 +372,7 @@ void loop()
       if (zoneIdx >= zones.size())
         zoneIdx = 0;
 
+      warmSelectedZones();
       drawSelectScreen();
     }
     break;
@@ -155,6 +381,7 @@ void loop()
     {
       state = State::SELECT;
       delete zoneManager;
+      warmSelectedZones();
       drawSelectScreen();
     }
     if (button2Res)
@@ -173,8 +400,10 @@ void loop()
     {
       zoneManager->mainThreadLoop();
     }
-    delay(10);
+    break;
   default:
     break;
   }
+
+  waitForNextEvent();
 }
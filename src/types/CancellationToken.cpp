@@ -0,0 +1,42 @@
+#include "types/CancellationToken.h"
+
+#include <Arduino.h>
+#include <algorithm>
+
+namespace
+{
+  const unsigned long POLL_PERIOD = 50; // ms
+}
+
+CancellationToken::CancellationToken() : m_cancelled{false} {}
+
+void CancellationToken::cancel() { m_cancelled = true; }
+void CancellationToken::reset() { m_cancelled = false; }
+bool CancellationToken::isCancelled() const { return m_cancelled; }
+
+/**
+ * Like delay(), but returns early if cancelled
+ *
+ * Returns false if cancelled
+ */
+bool CancellationToken::sleepFor(const unsigned long ms) const
+{
+  unsigned long start = millis();
+  while (!isCancelled())
+  {
+    unsigned long elapsed = millis() - start;
+    if (elapsed >= ms)
+      return true;
+    delay(std::min(POLL_PERIOD, ms - elapsed));
+  }
+  return false;
+}
+
+/**
+ * A token that is never cancelled, for work that always runs to completion
+ */
+const CancellationToken &CancellationToken::none()
+{
+  static const CancellationToken token;
+  return token;
+}
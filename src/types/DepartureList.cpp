@@ -3,8 +3,62 @@
 #include <Arduino.h>
 #include <string>
 #include <vector>
+#include <algorithm>
 
-DepartureList::DepartureList(const int numStored) : m_numStored{numStored} {}
+DepartureList::DepartureList(const int numStored) : m_numStored{numStored}
+{
+  if (m_numStored >= 0)
+  {
+    m_departures.reserve(m_numStored);
+  }
+}
+
+/**
+ * Copies leave the merge buffer behind; lists are copied into every
+ * snapshot, and only the list that merges needs its capacity
+ */
+DepartureList::DepartureList(const DepartureList &other)
+    : m_numStored{other.m_numStored}, m_departures{other.m_departures} {}
+
+DepartureList &DepartureList::operator=(const DepartureList &other)
+{
+  m_numStored = other.m_numStored;
+  m_departures = other.m_departures;
+  return *this;
+}
+
+/**
+ * k-way merge of sorted lists, keeping the earliest numStored departures
+ *
+ * Ties are taken from the earlier list first, matching repeated concat().
+ */
+DepartureList DepartureList::merge(const std::vector<DepartureList> &lists, const int numStored)
+{
+  DepartureList res(numStored);
+  std::vector<size_t> heads(lists.size(), 0);
+
+  while (!res.isFull(res.m_departures.size()))
+  {
+    int best = -1;
+    for (int i = 0; i < lists.size(); i++)
+    {
+      if (heads[i] >= lists[i].m_departures.size())
+        continue;
+      if (best == -1 ||
+          lists[i].m_departures[heads[i]].actualTimestamp < lists[best].m_departures[heads[best]].actualTimestamp)
+      {
+        best = i;
+      }
+    }
+    if (best == -1)
+      break;
+
+    res.m_departures.push_back(lists[best].m_departures[heads[best]]);
+    heads[best]++;
+  }
+
+  return res;
+}
 
 bool DepartureList::empty() const
 {
@@ -17,19 +71,34 @@ int DepartureList::size() const
 }
 
 /**
- * Gets all departures
- *
- * Assume that the departures are sorted
+ * Gets all departures, sorted by actual timestamp
  */
-std::vector<Departure> DepartureList::getDepartures() const
+const std::vector<Departure> &DepartureList::getDepartures() const
 {
-  std::vector<Departure> res;
-  for (const auto &dep : m_departures)
+  return m_departures;
+}
+
+/**
+ * Whether both lists hold the same trips at the same times
+ */
+bool DepartureList::hasSameDepartures(const DepartureList &other) const
+{
+  if (m_departures.size() != other.m_departures.size())
+    return false;
+
+  for (size_t i = 0; i < m_departures.size(); i++)
   {
-    res.push_back(dep.second);
+    const Departure &a = m_departures[i];
+    const Departure &b = other.m_departures[i];
+    if (a.route.onestopId != b.route.onestopId ||
+        a.direction != b.direction ||
+        a.actualTimestamp != b.actualTimestamp ||
+        a.isRealTime != b.isRealTime)
+    {
+      return false;
+    }
   }
-
-  return res;
+  return true;
 }
 
 std::vector<DisplayDeparture> DepartureList::getDisplayDepartureList(
@@ -41,17 +110,18 @@ std::vector<DisplayDeparture> DepartureList::getDisplayDepartureList(
     const int delayCutoff) const
 {
   std::vector<DisplayDeparture> res;
-  for (const auto &dep : m_departures)
+  res.reserve(m_departures.size());
+  for (const Departure &dep : m_departures)
   {
     DisplayDeparture dd;
-    dd.delayColor = getDelayColor(dep.second.delay, dep.second.isRealTime,
+    dd.delayColor = getDelayColor(dep.delay, dep.isRealTime,
                                   onTimeColor, delayedColor, earlyColor, noRtInfoColor, delayCutoff);
-    dd.direction = dep.second.direction;
-    dd.line = dep.second.route.name;
-    dd.mins = (dep.second.actualTimestamp - curTime) / 60;
-    dd.routeColor = dep.second.route.lineColor;
-    dd.textColor = dep.second.route.textColor;
-    dd.agencyOnestopId = dep.second.agencyOnestopId;
+    dd.direction = dep.direction;
+    dd.line = dep.route.name;
+    dd.mins = (dep.actualTimestamp - curTime) / 60;
+    dd.routeColor = dep.route.lineColor;
+    dd.textColor = dep.route.textColor;
+    dd.agencyOnestopId = dep.agencyOnestopId;
     res.push_back(dd);
   }
 
@@ -60,33 +130,60 @@ std::vector<DisplayDeparture> DepartureList::getDisplayDepartureList(
 
 void DepartureList::addDeparture(const Departure &departure)
 {
-  m_departures.insert({departure.actualTimestamp, departure});
-  if (m_numStored >= 0 && m_departures.size() > m_numStored)
+  // after any departures with the same timestamp
+  auto pos = std::upper_bound(m_departures.begin(), m_departures.end(), departure.actualTimestamp,
+                              [](const std::time_t time, const Departure &dep)
+                              { return time < dep.actualTimestamp; });
+  size_t idx = pos - m_departures.begin();
+
+  if (isFull(m_departures.size()))
   {
-    // remove the greatest timestamp because it won't be shown
-    m_departures.erase(std::prev(m_departures.end()));
+    // later than everything stored, so it won't be shown
+    if (idx == m_departures.size())
+      return;
+
+    // remove the greatest timestamp to make room
+    m_departures.pop_back();
   }
+  m_departures.insert(m_departures.begin() + idx, departure);
 }
 
+/**
+ * Two-way merge in O(numStored)
+ */
 void DepartureList::concat(const DepartureList &other)
 {
-  for (const auto &dep : other.m_departures)
+  m_scratch.clear();
+  size_t i = 0, j = 0;
+  while (!isFull(m_scratch.size()) && (i < m_departures.size() || j < other.m_departures.size()))
   {
-    addDeparture(dep.second);
+    // ties keep this list's departure first, like addDeparture
+    if (j >= other.m_departures.size() ||
+        (i < m_departures.size() && m_departures[i].actualTimestamp <= other.m_departures[j].actualTimestamp))
+    {
+      m_scratch.push_back(std::move(m_departures[i++]));
+    }
+    else
+    {
+      m_scratch.push_back(other.m_departures[j++]);
+    }
   }
+  m_departures.swap(m_scratch);
 }
 
 void DepartureList::removeAllBefore(const std::time_t time)
 {
-  m_departures.erase(m_departures.begin(), m_departures.lower_bound(time));
+  auto pos = std::lower_bound(m_departures.begin(), m_departures.end(), time,
+                              [](const Departure &dep, const std::time_t t)
+                              { return dep.actualTimestamp < t; });
+  m_departures.erase(m_departures.begin(), pos);
 }
 
 void DepartureList::shrinkTo(const int size)
 {
   if (m_departures.size() <= size)
     return;
-  auto it = std::next(m_departures.begin(), size);
-  m_departures.erase(it, m_departures.end());
+  m_departures.erase(m_departures.begin() + size, m_departures.end());
 }
 
 void DepartureList::clear()
@@ -103,11 +200,10 @@ void DepartureList::debugPrintAllDepartures() const
     return;
   }
 
-  for (const auto &d : m_departures)
+  for (const auto &dep : m_departures)
   {
     Serial.println(F("    ----------------------"));
 
-    const auto &dep = d.second;
     Serial.print(F("    Stop Name: "));
     Serial.println(dep.stop.name.c_str());
     Serial.print(F("    Route Name: "));
@@ -117,7 +213,7 @@ void DepartureList::debugPrintAllDepartures() const
     Serial.print(F("    Is Real-Time: "));
     Serial.println(dep.isRealTime ? "Yes" : "No");
     Serial.print(F("    Agency: "));
-    Serial.println(dep.agencyOnestopId.c_str());
+    Serial.println(StringInterner::str(dep.agencyOnestopId).c_str());
     Serial.print(F("    Exp timestamp: "));
     Serial.println(dep.expectedTimestamp);
     Serial.print(F("    Act timestamp: "));
@@ -130,6 +226,11 @@ void DepartureList::debugPrintAllDepartures() const
   Serial.println(F("    ----------------------"));
 }
 
+bool DepartureList::isFull(const size_t size) const
+{
+  return m_numStored >= 0 && size >= m_numStored;
+}
+
 int DepartureList::getDelayColor(
     int delay,
     bool isRealTime,
@@ -4,12 +4,12 @@
 #include <Arduino.h>
 #include <vector>
 
-bool RouteList::routeExists(const std::string &onestopId) const
+bool RouteList::routeExists(const InternId onestopId) const
 {
   return m_routes.find(onestopId) != m_routes.end();
 }
 
-Route RouteList::getRoute(const std::string &onestopId) const
+Route RouteList::getRoute(const InternId onestopId) const
 {
   auto it = m_routes.find(onestopId);
   if (it == m_routes.end())
@@ -19,6 +19,19 @@ Route RouteList::getRoute(const std::string &onestopId) const
   return it->second;
 }
 
+/**
+ * Returns nullptr if the route doesn't exist; valid while the list is unchanged
+ */
+const Route *RouteList::findRoute(const InternId onestopId) const
+{
+  auto it = m_routes.find(onestopId);
+  if (it == m_routes.end())
+  {
+    return nullptr;
+  }
+  return &it->second;
+}
+
 bool RouteList::empty() const
 {
   return m_routes.empty();
@@ -62,7 +75,7 @@ void RouteList::debugPrintAllRoutes() const
   {
     const auto &route = r.second;
     Serial.print(F("ID: "));
-    Serial.println(route.onestopId.c_str());
+    Serial.println(StringInterner::str(route.onestopId).c_str());
 
     Serial.print(F("Name: "));
     Serial.println(route.name.c_str());
@@ -74,7 +87,7 @@ void RouteList::debugPrintAllRoutes() const
     Serial.println(route.textColor, HEX);
 
     Serial.print(F("Agency ID: "));
-    Serial.println(route.agencyOnestopId.c_str());
+    Serial.println(StringInterner::str(route.agencyOnestopId).c_str());
 
     Serial.println(F("------------------"));
   }
@@ -5,12 +5,12 @@
 
 StopList::StopList() {}
 
-bool StopList::stopExists(const std::string &onestopId) const
+bool StopList::stopExists(const InternId onestopId) const
 {
   return m_stops.find(onestopId) != m_stops.end();
 }
 
-Stop StopList::getStop(const std::string &onestopId) const
+Stop StopList::getStop(const InternId onestopId) const
 {
   auto it = m_stops.find(onestopId);
   if (it == m_stops.end())
@@ -63,7 +63,7 @@ void StopList::debugPrintAllStops() const
   {
     const auto &stop = s.second;
     Serial.print(F("ID: "));
-    Serial.println(stop.onestopId.c_str());
+    Serial.println(StringInterner::str(stop.onestopId).c_str());
 
     Serial.print(F("Name: "));
     Serial.println(stop.name.c_str());
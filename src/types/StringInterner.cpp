@@ -0,0 +1,122 @@
+#include "types/StringInterner.h"
+
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <Arduino.h>
+
+namespace
+{
+  const size_t INTERNER_MAX_STRINGS = UINT16_MAX;
+
+  struct InternTable
+  {
+    std::mutex mtx;
+    std::deque<std::string> strings;                      // deque keeps references stable
+    std::unordered_map<std::string_view, InternId> index; // views into strings
+    size_t stringBytes = 0;
+
+    InternTable()
+    {
+      strings.emplace_back();
+      index.emplace(std::string_view(strings.back()), StringInterner::EMPTY);
+    }
+  };
+
+  // constructed on first use so other statics can intern during init
+  InternTable &table()
+  {
+    static InternTable t;
+    return t;
+  }
+}
+
+InternId StringInterner::intern(const char *str)
+{
+  if (str == nullptr || str[0] == '\0')
+    return EMPTY;
+
+  InternTable &t = table();
+  std::lock_guard<std::mutex> lock(t.mtx);
+  auto it = t.index.find(std::string_view(str));
+  if (it != t.index.end())
+    return it->second;
+
+  // handing out an ID already in use would make different IDs compare equal
+  if (t.strings.size() >= INTERNER_MAX_STRINGS)
+  {
+    Serial.println(F("String interner full, restarting"));
+    Serial.flush();
+    abort();
+  }
+
+  InternId id = t.strings.size();
+  t.strings.emplace_back(str);
+  t.stringBytes += t.strings.back().capacity() + 1;
+  t.index.emplace(std::string_view(t.strings.back()), id);
+  return id;
+}
+
+InternId StringInterner::intern(const std::string &str)
+{
+  return intern(str.c_str());
+}
+
+/**
+ * Looks up a string without adding it; EMPTY if it was never interned
+ */
+InternId StringInterner::find(const char *str)
+{
+  if (str == nullptr || str[0] == '\0')
+    return EMPTY;
+
+  InternTable &t = table();
+  std::lock_guard<std::mutex> lock(t.mtx);
+  auto it = t.index.find(std::string_view(str));
+  if (it == t.index.end())
+    return EMPTY;
+  return it->second;
+}
+
+/**
+ * The reference stays valid for the life of the program
+ */
+const std::string &StringInterner::str(const InternId id)
+{
+  InternTable &t = table();
+  std::lock_guard<std::mutex> lock(t.mtx);
+  if (id >= t.strings.size())
+    return t.strings[EMPTY];
+  return t.strings[id];
+}
+
+size_t StringInterner::count()
+{
+  InternTable &t = table();
+  std::lock_guard<std::mutex> lock(t.mtx);
+  return t.strings.size();
+}
+
+/**
+ * Approximate bytes held: string objects, their heap buffers and the index
+ */
+size_t StringInterner::memoryUsage()
+{
+  InternTable &t = table();
+  std::lock_guard<std::mutex> lock(t.mtx);
+  size_t indexBytes = t.index.bucket_count() * sizeof(void *) +
+                      t.index.size() * (sizeof(std::pair<const std::string_view, InternId>) + sizeof(void *) * 2);
+  return t.strings.size() * sizeof(std::string) + t.stringBytes + indexBytes;
+}
+
+void StringInterner::debugPrintStats()
+{
+  Serial.println(F("--- String Interner ---"));
+  Serial.print(F("Strings: "));
+  Serial.println(count());
+  Serial.print(F("Bytes: "));
+  Serial.println(memoryUsage());
+}
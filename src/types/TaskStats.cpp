@@ -0,0 +1,50 @@
+#include "types/TaskStats.h"
+
+#include <Arduino.h>
+
+TaskStats::TaskStats() : m_startMs{0}, m_waitStartMicros{0}, m_idleMicros{0}, m_wakeups{0} {}
+
+void TaskStats::beginWait()
+{
+  if (m_startMs == 0)
+    m_startMs = millis();
+  m_waitStartMicros = micros();
+}
+
+void TaskStats::endWait()
+{
+  m_idleMicros += micros() - m_waitStartMicros;
+  m_wakeups++;
+}
+
+void TaskStats::reset()
+{
+  m_startMs = millis();
+  m_idleMicros = 0;
+  m_wakeups = 0;
+}
+
+float TaskStats::getIdlePercent() const
+{
+  unsigned long elapsedMs = millis() - m_startMs;
+  if (m_startMs == 0 || elapsedMs == 0)
+    return 0;
+  return 100.0f * (m_idleMicros / 1000.0f) / elapsedMs;
+}
+
+float TaskStats::getWakeupsPerMinute() const
+{
+  unsigned long elapsedMs = millis() - m_startMs;
+  if (m_startMs == 0 || elapsedMs == 0)
+    return 0;
+  return m_wakeups * 60000.0f / elapsedMs;
+}
+
+void TaskStats::debugPrint(const char *name) const
+{
+  Serial.print(name);
+  Serial.print(F(" idle: "));
+  Serial.print(getIdlePercent());
+  Serial.print(F("%, wakeups/min: "));
+  Serial.println(getWakeupsPerMinute());
+}
@@ -3,18 +3,28 @@
 #include <vector>
 #include <unordered_set>
 #include <string>
+#include <algorithm>
 
 Whitelist::Whitelist() : m_isActive{false} {}
 
 Whitelist::Whitelist(const std::vector<std::string> &whitelist, bool active)
-    : m_whitelist(whitelist.begin(), whitelist.end()), m_isActive{active} {}
+    : m_isActive{active}
+{
+  for (const auto &item : whitelist)
+    addItem(item);
+}
 
 Whitelist::Whitelist(const std::unordered_set<std::string> &whitelist, bool active)
-    : m_whitelist(whitelist), m_isActive{active} {}
+    : m_isActive{active}
+{
+  for (const auto &item : whitelist)
+    addItem(item);
+}
 
 void Whitelist::addItem(const std::string &item)
 {
   m_whitelist.insert(item);
+  m_ids.insert(StringInterner::intern(item));
 }
 
 bool Whitelist::inWhitelist(const std::string &item) const
@@ -22,9 +32,15 @@ bool Whitelist::inWhitelist(const std::string &item) const
   return m_whitelist.find(item) != m_whitelist.end();
 }
 
+bool Whitelist::inWhitelist(const InternId item) const
+{
+  return m_ids.find(item) != m_ids.end();
+}
+
 void Whitelist::removeItem(const std::string &item)
 {
   m_whitelist.erase(item);
+  m_ids.erase(StringInterner::intern(item));
 }
 
 void Whitelist::setActive(const bool active) { m_isActive = active; }
@@ -42,5 +58,15 @@ std::string Whitelist::getWhiteListStr() const
     res += item + ",";
   }
 
+  return res;
+}
+
+/**
+ * Returns the items in sorted order
+ */
+std::vector<std::string> Whitelist::getItems() const
+{
+  std::vector<std::string> res(m_whitelist.begin(), m_whitelist.end());
+  std::sort(res.begin(), res.end());
   return res;
 }
\ No newline at end of file